@@ -0,0 +1,134 @@
+import os
+import sys
+import argparse
+import subprocess
+import time
+
+### Settings ###
+
+OUT_DIR = "bench/out"
+TIMEOUT = 600
+
+# name -> (generator, size) for each scale
+SCALES = {
+    "small": [("long", 10_000), ("nested", 100), ("init", 10_000), ("funcs", 1_000)],
+    "full": [("long", 10_000), ("long", 100_000), ("long", 1_000_000),
+             ("nested", 1_000), ("init", 1_000_000), ("funcs", 10_000)],
+}
+
+### Generators ###
+# Every program is valid SysY that terminates, so the same inputs can also
+# be run through the IR interpreter.
+
+
+def gen_long(n: int) -> str:
+    """main with about n lines of straight-line code, ifs and short loops."""
+    lines = ["int main() {", "    int a = 1;", "    int b = 2;", "    int c = 3;", "    int i = 0;"]
+    body = [
+        "    a = a + b * 3 - c;",
+        "    b = (b + a) % 1000 + 1;",
+        "    c = c * 2 / 3 + a - b;",
+        "    if (a > b && c != 0) a = a - c; else b = b + 1;",
+        "    i = 0;",
+        "    while (i < 3) { c = c + i; i = i + 1; }",
+    ]
+    lines += [body[k % len(body)] for k in range(n)]
+    lines += ["    return a % 256;", "}"]
+    return "\n".join(lines) + "\n"
+
+
+def gen_nested(depth: int) -> str:
+    """depth nested blocks alternating between if and while."""
+    lines = ["int main() {", "    int a = 0;"]
+    for d in range(depth):
+        if d % 2 == 0:
+            lines.append(f"{'  ' * d}    if (a < {d + 1}) {{")
+        else:
+            lines.append(f"{'  ' * d}    while (a < {d + 1}) {{")
+        lines.append(f"{'  ' * d}      a = a + 1;")
+    for d in reversed(range(depth)):
+        lines.append(f"{'  ' * d}    }}")
+    lines += ["    return a % 256;", "}"]
+    return "\n".join(lines) + "\n"
+
+
+def gen_init(n: int) -> str:
+    """A global 2-D array with an n-element initializer, in the mixed
+    flat/braced style of array_init3.sy, and a local copy of one row."""
+    cols = 1000 if n >= 1000 else n
+    rows = n // cols
+    lines = [f"int g[{rows}][{cols}] = {{"]
+    for r in range(rows):
+        values = ", ".join(str((r * 31 + c * 7) % 1000) for c in range(cols))
+        # alternate braced rows and flat rows
+        row = f"    {{{values}}}" if r % 2 == 0 else f"    {values}"
+        lines.append(row + ("," if r + 1 < rows else ""))
+    lines += ["};", "int main() {", f"    int l[{cols}] = {{1, 2, {{3}}}};", "    int i = 0;",
+              "    int s = 0;", f"    while (i < {cols}) {{ s = s + g[{rows - 1}][i] + l[i]; i = i + 1; }}",
+              "    return s % 256;", "}"]
+    return "\n".join(lines) + "\n"
+
+
+def gen_funcs(n: int) -> str:
+    """n small functions, each calling the one before it."""
+    lines = ["int fn_0(int x) {", "    return x;", "}"]
+    for k in range(1, n):
+        lines += [f"int fn_{k}(int x) {{",
+                  f"    if (x > {k}) return fn_{k - 1}(x - 1) + 1;",
+                  f"    return fn_{k - 1}(x) * 2 % 1000;", "}"]
+    lines += ["int main() {", f"    return fn_{n - 1}(3) % 256;", "}"]
+    return "\n".join(lines) + "\n"
+
+
+GENERATORS = {"long": gen_long, "nested": gen_nested, "init": gen_init, "funcs": gen_funcs}
+
+### Runner ###
+
+
+def generate(scale: str) -> list[str]:
+    os.makedirs(OUT_DIR, exist_ok=True)
+    files = []
+    for kind, size in SCALES[scale]:
+        filename = os.path.join(OUT_DIR, f"{kind}_{size}.sy")
+        if not os.path.exists(filename):  # inputs are deterministic, keep them
+            with open(filename, "w") as f:
+                f.write(GENERATORS[kind](size))
+        files.append(filename)
+    return files
+
+
+def bench_one(compiler: str, filename: str) -> float | None:
+    ir_file = filename[:-3] + ".ir"
+    start = time.perf_counter()
+    try:
+        result = subprocess.run([compiler, "--time", filename, ir_file],
+                                capture_output=True, text=True, timeout=TIMEOUT)
+    except subprocess.TimeoutExpired:
+        print(f"{filename}: timed out")
+        return None
+    elapsed = time.perf_counter() - start
+    # the compiler prints its own per-phase report to stderr
+    print(result.stderr, end="")
+    if result.returncode != 0:
+        print(f"{filename}: compiler exited with {result.returncode}")
+        return None
+    return elapsed
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Benchmark the compiler on large generated programs.")
+    parser.add_argument("compiler", type=str, help="Your compiler binary")
+    parser.add_argument("--scale", type=str, default="full", choices=list(SCALES),
+                        help="Which set of input sizes to run")
+    args = parser.parse_args()
+    if not os.path.exists(args.compiler):
+        print(f"File {args.compiler} not found.")
+        sys.exit(1)
+    files = generate(args.scale)
+    results = [(f, bench_one(args.compiler, f)) for f in files]
+    print()
+    width = max(len(f) for f in files)
+    print(f"{'input'.ljust(width)}  {'wall':>10}")
+    for f, elapsed in results:
+        print(f"{f.ljust(width)}  " + (f"{elapsed * 1000:8.1f}ms" if elapsed is not None else "    failed"))
+    sys.exit(0 if all(e is not None for _, e in results) else 1)
@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+// Bump allocator: memory is carved out of large blocks and released all at
+// once when the arena is destroyed or reset. Nothing allocated here gets a
+// destructor call, so only trivially destructible data belongs in it.
+class Arena {
+ public:
+  explicit Arena(size_t block_size = 256 * 1024) : block_size_(block_size) {}
+  ~Arena() { reset(); }
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *alloc(size_t size, size_t align = alignof(max_align_t)) {
+    size_t pad = (align - ((size_t)cur_ & (align - 1))) & (align - 1);
+    if (cur_ == nullptr || size + pad > (size_t)(end_ - cur_)) {
+      grow(size + align);
+      pad = (align - ((size_t)cur_ & (align - 1))) & (align - 1);
+    }
+    char *p = cur_ + pad;
+    cur_ = p + size;
+    return p;
+  }
+
+  template <class T>
+  T *alloc_array(size_t n) {
+    return static_cast<T *>(alloc(sizeof(T) * n, alignof(T)));
+  }
+
+  // Copy `n` bytes of `s` and terminate them with a NUL.
+  char *strdup(const char *s, size_t n) {
+    char *p = static_cast<char *>(alloc(n + 1, 1));
+    memcpy(p, s, n);
+    p[n] = '\0';
+    return p;
+  }
+
+  // Free every block at once.
+  void reset() {
+    while (head_) {
+      Block *next = head_->next;
+      free(head_);
+      head_ = next;
+    }
+    cur_ = end_ = nullptr;
+  }
+
+ private:
+  struct Block {
+    Block *next;
+  };
+
+  void grow(size_t min_size) {
+    size_t size = min_size > block_size_ ? min_size : block_size_;
+    Block *b = static_cast<Block *>(malloc(sizeof(Block) + size));
+    if (!b) throw std::bad_alloc();
+    b->next = head_;
+    head_ = b;
+    cur_ = reinterpret_cast<char *>(b + 1);
+    end_ = cur_ + size;
+  }
+
+  size_t block_size_;
+  Block *head_ = nullptr;
+  char *cur_ = nullptr;
+  char *end_ = nullptr;
+};
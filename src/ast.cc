@@ -0,0 +1,90 @@
+#include "ast.hh"
+
+Ast::Ast() {
+  make(N_NONE, 0);  // index 0 is the null node
+}
+
+NodeId Ast::make(NodeKind kind, int line, NodeId a, NodeId b, NodeId c) {
+  if ((count_ & chunk_mask) == 0) chunks_.push_back(arena_.alloc_array<Node>(1u << chunk_bits));
+  NodeId id = count_++;
+  (*this)[id] = Node{kind, 0, 0, T_INT, 0, line, 0, 0, {0}, a, b, c, 0};
+  return id;
+}
+
+NodeList Ast::append(NodeList l, NodeId n) {
+  if (!l.head) return list(n);
+  (*this)[l.tail].next = n;
+  return NodeList{l.head, n};
+}
+
+bool fold_op(int op, int32_t a, int32_t b, int32_t &r) {
+  uint32_t x = a, y = b;
+  switch (op) {
+    case OP_ADD: r = x + y; return true;
+    case OP_SUB: r = x - y; return true;
+    case OP_MUL: r = x * y; return true;
+    case OP_DIV:
+    case OP_MOD:
+      if (b == 0) return false;
+      if (b == -1) r = op == OP_DIV ? 0u - x : 0;  // INT_MIN / -1 wraps
+      else r = op == OP_DIV ? a / b : a % b;
+      return true;
+    case OP_LT: r = a < b; return true;
+    case OP_GT: r = a > b; return true;
+    case OP_LE: r = a <= b; return true;
+    case OP_GE: r = a >= b; return true;
+    case OP_EQ: r = a == b; return true;
+    case OP_NE: r = a != b; return true;
+    case OP_AND: r = a && b; return true;
+    case OP_OR: r = a || b; return true;
+    case OP_NEG: r = 0u - x; return true;
+    case OP_POS: r = a; return true;
+    case OP_NOT: r = !a; return true;
+  }
+  return false;
+}
+
+static const char *const kind_names[] = {
+  "None", "CompUnit", "FuncDef", "Param", "VarDecl", "VarDef", "InitList",
+  "Block", "Assign", "ExpStmt", "Empty", "If", "While", "Break", "Continue",
+  "Return", "Number", "LVal", "Call", "Unary", "Binary",
+};
+
+static const char *const op_names[] = {
+  "+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=", "&&", "||", "-", "+", "!",
+};
+
+void Ast::dump(FILE *out) const { dump(out, root, 0); }
+
+void Ast::dump(FILE *out, NodeId id, int depth) const {
+  for (; id; id = (*this)[id].next) {
+    const Node &n = (*this)[id];
+    fprintf(out, "%*s%s", depth * 2, "", kind_names[n.kind]);
+    switch (n.kind) {
+      case N_FUNC_DEF:
+      case N_PARAM:
+      case N_VAR_DEF:
+      case N_LVAL:
+      case N_CALL:
+        fprintf(out, " %s", name_of(n.name));
+        break;
+      case N_NUMBER:
+        fprintf(out, " %d", n.value);
+        break;
+      case N_UNARY:
+      case N_BINARY:
+        fprintf(out, " %s", op_names[n.op]);
+        break;
+      default:
+        break;
+    }
+    if (n.flags & F_VOID) fprintf(out, " void");
+    if (n.kind == N_VAR_DEF && (n.flags & F_CONST)) fprintf(out, " const");
+    if (n.flags & F_ARRAY) fprintf(out, " []");
+    fprintf(out, "  (line %d)\n", n.line);
+    if (n.kind == N_NONE) continue;
+    dump(out, n.a, depth + 1);
+    dump(out, n.b, depth + 1);
+    dump(out, n.c, depth + 1);
+  }
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "arena.hh"
+#include "interner.hh"
+
+// Abstract syntax tree of a SysY translation unit.
+//
+// Nodes are fixed-size records stored in arena chunks and refer to each
+// other by 32-bit index; index 0 is the null node. Lists (items of a block,
+// parameters, arguments, array dimensions, ...) are chained through `next`.
+// The whole tree goes away at once with its Ast.
+
+typedef uint32_t NodeId;
+
+enum NodeKind : uint8_t {
+  N_NONE,
+  N_COMP_UNIT,  // a: list of N_VAR_DECL / N_FUNC_DEF
+  N_FUNC_DEF,   // name, a: params, b: body block; F_VOID
+  N_PARAM,      // name, a: dims after the leading []; F_ARRAY
+  N_VAR_DECL,   // a: list of N_VAR_DEF
+  N_VAR_DEF,    // name, a: dims, b: initializer (exp or N_INIT_LIST)
+  N_INIT_LIST,  // a: elements
+  N_BLOCK,      // a: items
+  N_ASSIGN,     // a: N_LVAL, b: exp
+  N_EXP_STMT,   // a: exp
+  N_EMPTY,
+  N_IF,         // a: cond, b: then, c: else
+  N_WHILE,      // a: cond, b: body
+  N_BREAK,
+  N_CONTINUE,
+  N_RETURN,     // a: exp or null
+  N_NUMBER,     // value
+  N_LVAL,       // name, decl, a: indices
+  N_CALL,       // name, decl, a: arguments
+  N_UNARY,      // op, a
+  N_BINARY,     // op, a, b
+};
+
+enum Op : uint8_t {
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+  OP_LT, OP_GT, OP_LE, OP_GE, OP_EQ, OP_NE,
+  OP_AND, OP_OR,
+  OP_NEG, OP_POS, OP_NOT,
+};
+
+// Value of `a op b` (`op a` for the unary ones, b ignored) with 32-bit
+// wraparound; false when it is undefined.
+bool fold_op(int op, int32_t a, int32_t b, int32_t &r);
+
+enum NodeFlag : uint8_t {
+  F_VOID = 1,     // N_FUNC_DEF returning void
+  F_ARRAY = 2,    // N_PARAM declared as `int a[]...`
+  F_BUILTIN = 4,  // N_FUNC_DEF of a runtime function (read, write)
+  F_CONST = 8,    // expression whose value is known at compile time;
+                  // N_VAR_DEF declared `const`
+};
+
+// Type of an expression, filled in by Sema.
+enum TypeKind : uint8_t {
+  T_INT,
+  T_VOID,
+  T_ARRAY,  // `rank` dimensions left, shape from the declaration
+};
+
+// An element of an initializer: its row-major index in the variable and
+// its expression.
+struct InitElem {
+  int64_t index;
+  NodeId exp;
+};
+
+struct InitRange {
+  const InitElem *first, *last;
+  const InitElem *begin() const { return first; }
+  const InitElem *end() const { return last; }
+  size_t size() const { return last - first; }
+};
+
+struct Node {
+  NodeKind kind;
+  uint8_t op;
+  uint8_t flags;
+  TypeKind type;   // expressions
+  uint8_t rank;    // T_ARRAY
+  int32_t line;
+  int32_t value;   // N_NUMBER and F_CONST expressions; N_VAR_DEF with an
+                   // initializer: offset of its image in Ast::inits
+  uint32_t name;   // interned identifier of named nodes
+  union {
+    NodeId decl;     // N_LVAL, N_CALL: declaration the name resolves to
+    uint32_t shape;  // N_VAR_DEF, N_PARAM: offset of the shape in Ast::shapes
+  };
+  NodeId a, b, c;
+  NodeId next;     // next element of the list this node is in
+};
+
+// Head and tail of a list under construction.
+struct NodeList {
+  NodeId head, tail;
+};
+
+class Ast {
+ public:
+  Ast();
+
+  NodeId make(NodeKind kind, int line, NodeId a = 0, NodeId b = 0, NodeId c = 0);
+  Node &operator[](NodeId id) { return chunks_[id >> chunk_bits][id & chunk_mask]; }
+  const Node &operator[](NodeId id) const { return chunks_[id >> chunk_bits][id & chunk_mask]; }
+  uint32_t size() const { return count_; }
+
+  NodeList list() { return NodeList{0, 0}; }
+  NodeList list(NodeId first) { return NodeList{first, first}; }
+  NodeList append(NodeList l, NodeId n);
+
+  const char *name_of(uint32_t name) const { return names.str(name); }
+
+  // Print the tree as indented text, for debugging.
+  void dump(FILE *out) const;
+
+  NodeId root = 0;
+  Interner names;  // identifiers of this translation unit
+
+  // Array shapes of declarations: at offset `shape` of a variable or
+  // parameter is its rank r followed by r dimension sizes, outermost
+  // first. The leading size of an array parameter is 0. Offset 0 holds
+  // the shape of every scalar.
+  std::vector<int32_t> shapes{0};
+  const int32_t *shape_of(NodeId decl) const { return &shapes[(*this)[decl].shape]; }
+
+  // Initializers, as the elements that may be non-zero in increasing
+  // row-major order; every element not listed is zero, so `= {}` lists
+  // none. At offset `value` of an N_VAR_DEF is the number of its elements,
+  // in the index of an entry with no expression, and the elements follow.
+  // Filled by Sema as each N_VAR_DEF is checked.
+  std::vector<InitElem> inits;
+  InitRange init_of(NodeId def) const {
+    const InitElem *head = &inits[(*this)[def].value];
+    return InitRange{head + 1, head + 1 + head->index};
+  }
+
+ private:
+  static const unsigned chunk_bits = 12;
+  static const unsigned chunk_mask = (1u << chunk_bits) - 1;
+
+  void dump(FILE *out, NodeId id, int depth) const;
+
+  Arena arena_;
+  std::vector<Node *> chunks_;
+  uint32_t count_ = 0;
+};
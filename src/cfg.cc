@@ -0,0 +1,182 @@
+#include "cfg.hh"
+#include <algorithm>
+
+namespace {
+
+bool is_terminator(IrOp op) { return op == IR_GOTO || op == IR_IF || op == IR_RET; }
+
+}  // namespace
+
+Cfg::Cfg(IrFunction &f) : f(f) {
+  // Blocks start at labels and after terminators. Instructions after a
+  // terminator and before the next label are unreachable but still get a
+  // block here; it is dropped below.
+  std::vector<Block> raw(1);
+  std::vector<uint32_t> block_of(f.labels + 1);
+  for (const IrInst &i : f.code) {
+    if (i.op == IR_LABEL) {
+      if (!raw.back().code.empty() || raw.size() == 1) raw.emplace_back();
+      block_of[i.imm] = raw.size() - 1;
+      continue;
+    }
+    if (!raw.back().code.empty() && is_terminator(raw.back().code.back().op)) raw.emplace_back();
+    raw.back().code.push_back(i);
+  }
+  // Every block now ends in a terminator whose targets are blocks.
+  for (uint32_t b = 0; b < raw.size(); b++) {
+    std::vector<IrInst> &code = raw[b].code;
+    if (code.empty() || !is_terminator(code.back().op)) {
+      code.push_back(IrInst{IR_GOTO, 0, 0, 0, 0, 0});
+      raw[b].succs.push_back(b + 1);
+      continue;
+    }
+    IrInst &t = code.back();
+    if (t.op == IR_RET) continue;
+    uint32_t target = block_of[t.imm];
+    raw[b].succs.push_back(target);
+    if (t.op == IR_IF && target != b + 1) raw[b].succs.push_back(b + 1);
+    if (t.op == IR_IF && target == b + 1) t = IrInst{IR_GOTO, 0, 0, 0, 0, 0};
+  }
+  // A label never shares raw[0], so nothing jumps to the entry. Keep the
+  // blocks reachable from it, in their order.
+  std::vector<uint32_t> index(raw.size(), UINT32_MAX), stack{0};
+  index[0] = 0;
+  while (!stack.empty()) {
+    uint32_t b = stack.back();
+    stack.pop_back();
+    for (uint32_t s : raw[b].succs) {
+      if (index[s] == UINT32_MAX) {
+        index[s] = 0;
+        stack.push_back(s);
+      }
+    }
+  }
+  uint32_t n = 0;
+  for (uint32_t b = 0; b < raw.size(); b++) {
+    if (index[b] != UINT32_MAX) index[b] = n++;
+  }
+  blocks.resize(n);
+  for (uint32_t b = 0; b < raw.size(); b++) {
+    if (index[b] == UINT32_MAX) continue;
+    Block &block = blocks[index[b]];
+    block.code = std::move(raw[b].code);
+    for (uint32_t s : raw[b].succs) {
+      block.succs.push_back(index[s]);
+      blocks[index[s]].preds.push_back(index[b]);
+    }
+  }
+}
+
+uint32_t Cfg::add_block() {
+  blocks.emplace_back();
+  return blocks.size() - 1;
+}
+
+uint32_t Cfg::split_edge(uint32_t from, int i) {
+  uint32_t mid = add_block();
+  uint32_t to = blocks[from].succs[i];
+  blocks[mid].code.push_back(IrInst{IR_GOTO, 0, 0, 0, 0, 0});
+  blocks[mid].preds.push_back(from);
+  blocks[mid].succs.push_back(to);
+  blocks[from].succs[i] = mid;
+  std::vector<uint32_t> &preds = blocks[to].preds;
+  *std::find(preds.begin(), preds.end(), from) = mid;
+  return mid;
+}
+
+void Cfg::remove_pred(uint32_t to, uint32_t from) {
+  std::vector<uint32_t> &preds = blocks[to].preds;
+  size_t k = std::find(preds.begin(), preds.end(), from) - preds.begin();
+  size_t n = preds.size();
+  for (const IrInst &i : blocks[to].code) {
+    if (i.op != IR_PHI) break;
+    uint32_t *args = phi_args(i);
+    std::copy(args + k + 1, args + n, args + k);
+  }
+  preds.erase(preds.begin() + k);
+}
+
+void Cfg::remove_unreachable() {
+  uint32_t n = blocks.size();
+  std::vector<uint32_t> index(n, UINT32_MAX), stack{0};
+  index[0] = 0;
+  while (!stack.empty()) {
+    uint32_t b = stack.back();
+    stack.pop_back();
+    for (uint32_t s : blocks[b].succs) {
+      if (index[s] == UINT32_MAX) {
+        index[s] = 0;
+        stack.push_back(s);
+      }
+    }
+  }
+  for (uint32_t b = 0; b < n; b++) {
+    if (index[b] != UINT32_MAX) continue;
+    for (uint32_t s : blocks[b].succs) {
+      if (index[s] != UINT32_MAX) remove_pred(s, b);
+    }
+  }
+  uint32_t live = 0;
+  for (uint32_t b = 0; b < n; b++) {
+    if (index[b] == UINT32_MAX) continue;
+    index[b] = live;
+    if (live != b) blocks[live] = std::move(blocks[b]);
+    live++;
+  }
+  blocks.resize(live);
+  for (Block &block : blocks) {
+    for (uint32_t &p : block.preds) p = index[p];
+    for (uint32_t &s : block.succs) s = index[s];
+  }
+}
+
+void Cfg::add_phi(uint32_t block, uint32_t value) {
+  std::vector<IrInst> &code = blocks[block].code;
+  auto at = std::find_if(code.begin(), code.end(), [](const IrInst &i) { return i.op != IR_PHI; });
+  code.insert(at, IrInst{IR_PHI, 0, value, uint32_t(phi_args_.size()), value, 0});
+  phi_args_.resize(phi_args_.size() + blocks[block].preds.size());
+}
+
+void Cfg::flatten() {
+  uint32_t n = blocks.size();
+  std::vector<int32_t> label(n);
+  auto need = [&](uint32_t b) { label[b] = 1; };
+  for (uint32_t b = 0; b < n; b++) {
+    const Block &block = blocks[b];
+    switch (block.code.back().op) {
+      case IR_GOTO:
+        if (block.succs[0] != b + 1) need(block.succs[0]);
+        break;
+      case IR_IF:
+        // with the taken target next, the condition is negated instead
+        if (block.succs[0] != b + 1) need(block.succs[0]);
+        if (block.succs[0] == b + 1 || block.succs[1] != b + 1) need(block.succs[1]);
+        break;
+      default:
+        break;
+    }
+  }
+  f.labels = 0;
+  for (uint32_t b = 0; b < n; b++) {
+    if (label[b]) label[b] = f.new_label();
+  }
+
+  f.code.clear();
+  for (uint32_t b = 0; b < n; b++) {
+    const Block &block = blocks[b];
+    if (label[b]) f.emit(IR_LABEL, 0, 0, 0, label[b]);
+    for (const IrInst &i : block.code) {
+      if (i.op == IR_PHI) continue;
+      if (i.op == IR_GOTO) {
+        if (block.succs[0] != b + 1) f.emit(IR_GOTO, 0, 0, 0, label[block.succs[0]]);
+      } else if (i.op == IR_IF && block.succs[0] == b + 1) {
+        f.emit(IR_IF, 0, i.a, i.b, label[block.succs[1]], ir_negate(i.sub));
+      } else if (i.op == IR_IF) {
+        f.emit(IR_IF, 0, i.a, i.b, label[block.succs[0]], i.sub);
+        if (block.succs[1] != b + 1) f.emit(IR_GOTO, 0, 0, 0, label[block.succs[1]]);
+      } else {
+        f.code.push_back(i);
+      }
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "ir.hh"
+
+// Control-flow graph of an IrFunction, the form the optimizations work on.
+//
+// Each block holds its instructions in one vector: IR_PHI first, then the
+// body, then exactly one terminator. There are no labels; a terminator's
+// targets are the block's successors:
+//   IR_GOTO  succs[0]
+//   IR_IF    succs[0] if the condition holds, else succs[1]
+//   IR_RET   none
+// An IR_PHI's operands are in phi_args from offset `a` on, one per
+// predecessor in the order of `preds`; its `b` is the value it was
+// placed for.
+struct Block {
+  std::vector<IrInst> code;
+  std::vector<uint32_t> preds, succs;
+};
+
+class Cfg {
+ public:
+  // Split f.code into blocks. Unreachable code is dropped, an IF whose
+  // two targets are the same block becomes a GOTO, and the entry block has
+  // no predecessors.
+  explicit Cfg(IrFunction &f);
+
+  // Write the blocks back to f.code in block order, with fresh labels on
+  // the blocks that are jumped to and no GOTO to the next block.
+  void flatten();
+
+  uint32_t add_block();
+  // Put a block on the edge from `from` to its successor number `i` and
+  // return it.
+  uint32_t split_edge(uint32_t from, int i);
+  // Remove the edge from `from` to `to` from the predecessors of `to`
+  // and from its phis. The caller fixes `from`'s terminator and succs.
+  void remove_pred(uint32_t to, uint32_t from);
+  // Drop the blocks the entry no longer reaches and renumber the others,
+  // keeping their order.
+  void remove_unreachable();
+
+  uint32_t *phi_args(const IrInst &phi) { return &phi_args_[phi.a]; }
+  void add_phi(uint32_t block, uint32_t value);
+
+  IrFunction &f;
+  std::vector<Block> blocks;  // blocks[0] is the entry
+  // Set by to_ssa: the value each SSA value is a version of. Values made
+  // after that are versions of themselves.
+  std::vector<uint32_t> origin;
+  uint32_t origin_of(uint32_t v) const { return v < origin.size() ? origin[v] : v; }
+
+ private:
+  std::vector<uint32_t> phi_args_;
+};
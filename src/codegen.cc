@@ -0,0 +1,482 @@
+#include "codegen.hh"
+#include <string.h>
+#include <charconv>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "cfg.hh"
+#include "dominance.hh"
+#include "ir.hh"
+#include "opt.hh"
+#include "ssa.hh"
+#include "work_pool.hh"
+
+namespace {
+
+// IR spelling of source names. The compiler names its own temporaries and
+// labels with a letter and digits (t1, L2), so source names of that form,
+// names that are IR keywords and names starting with '_' get a '_' in
+// front. Different source names still map to different IR names.
+std::string ir_name(const char *name) {
+  static const char *const keywords[] = {
+    "LABEL", "GOTO", "IF", "PARAM", "ARG", "RETURN", "CALL", "FUNCTION", "DEC", "GLOBAL",
+  };
+  bool reserved = name[0] == '_';
+  if (!reserved && name[1] != '\0') {
+    reserved = true;
+    for (const char *p = name + 1; *p; p++) reserved = reserved && *p >= '0' && *p <= '9';
+  }
+  for (const char *k : keywords) reserved = reserved || strcmp(name, k) == 0;
+  return reserved ? std::string("_") + name : std::string(name);
+}
+
+struct Unit {
+  const Ast &ast;
+  std::vector<std::string> names;  // IR name of each interned name
+  std::vector<char> global;        // per interned name: declared at file scope
+};
+
+// Number of elements of an array with `rank` dimensions `dims`.
+int64_t element_count(const int32_t *dims, int rank) {
+  int64_t size = 1;
+  for (int i = 0; i < rank; i++) size *= dims[i];
+  return size;
+}
+
+// Lowering of one function body into three-address code. Source locals
+// keep their names unless another local of the function already has it or
+// it is also a file-scope name (ir.py looks a called name up among the
+// caller's variables first); those become temporaries.
+class Lowering {
+ public:
+  Lowering(const Unit &unit, NodeId func) : unit_(unit), ast_(unit.ast), func_(func) {}
+
+  void run(IrFunction &f);
+
+ private:
+  // Zero elements of a local array initializer that are stored one by
+  // one; with more, the array is cleared by a loop first.
+  static const int64_t max_zero_stores = 4;
+
+  struct Loop {
+    int32_t next, exit;  // continue and break targets
+  };
+
+  uint32_t local(NodeId decl);
+  void block(NodeId items);
+  void stmt(NodeId s);
+  void var_def(NodeId def);
+  void zero_fill(uint32_t base, int64_t size);
+  void assign(uint32_t dst, NodeId e);
+  uint32_t exp(NodeId e);
+  uint32_t arith(uint8_t op, NodeId a, NodeId b);
+  uint32_t call(NodeId e);
+  uint32_t truth(NodeId e);
+  uint32_t base(NodeId decl);
+  uint32_t element(NodeId lval);
+  void cond(NodeId e, int32_t yes, int32_t no);
+
+  // A temporary holding `value`, loaded at most once per basic block.
+  uint32_t li(int32_t value) {
+    uint32_t &t = consts_[value];
+    if (!t) {
+      t = f_->new_temp();
+      f_->emit(IR_LI, t, 0, 0, value);
+    }
+    return t;
+  }
+  uint32_t bin(uint8_t op, uint32_t a, uint32_t b) {
+    uint32_t t = f_->new_temp();
+    f_->emit(IR_BIN, t, a, b, 0, op);
+    return t;
+  }
+  uint32_t bini(uint8_t op, uint32_t a, int32_t imm) {
+    uint32_t t = f_->new_temp();
+    f_->emit(IR_BINI, t, a, 0, imm, op);
+    return t;
+  }
+  uint32_t load(uint32_t addr) {
+    uint32_t t = f_->new_temp();
+    f_->emit(IR_LOAD, t, addr);
+    return t;
+  }
+  void label(int32_t l) {
+    f_->emit(IR_LABEL, 0, 0, 0, l);
+    consts_.clear();
+  }
+  void jump(int32_t l) { f_->emit(IR_GOTO, 0, 0, 0, l); }
+
+  const Unit &unit_;
+  const Ast &ast_;
+  NodeId func_;
+  IrFunction *f_ = nullptr;
+  std::unordered_map<NodeId, uint32_t> locals_;  // declaration -> value
+  std::unordered_set<uint32_t> taken_;           // interned names in use
+  std::vector<Loop> loops_;
+  std::unordered_map<int32_t, uint32_t> consts_;  // li() of the current block
+};
+
+void Lowering::run(IrFunction &f) {
+  f_ = &f;
+  const Node &fn = ast_[func_];
+  f.name = fn.name;
+  for (NodeId p = fn.a; p; p = ast_[p].next) f.emit(IR_PARAM, local(p));
+  block(ast_[fn.b].a);
+  // falling off the end returns 0 (only main may rely on that)
+  if (f.code.empty() || (f.code.back().op != IR_RET && f.code.back().op != IR_GOTO)) {
+    f.emit(IR_RET, 0, fn.flags & F_VOID ? 0 : li(0));
+  }
+}
+
+uint32_t Lowering::local(NodeId decl) {
+  uint32_t name = ast_[decl].name;
+  bool own = !unit_.global[name] && taken_.insert(name).second;
+  uint32_t v = own ? f_->new_named(name) : f_->new_temp();
+  locals_[decl] = v;
+  return v;
+}
+
+void Lowering::block(NodeId items) {
+  for (NodeId s = items; s; s = ast_[s].next) stmt(s);
+}
+
+void Lowering::stmt(NodeId s) {
+  const Node &n = ast_[s];
+  switch (n.kind) {
+    case N_VAR_DECL:
+      for (NodeId def = n.a; def; def = ast_[def].next) var_def(def);
+      break;
+    case N_BLOCK:
+      block(n.a);
+      break;
+    case N_ASSIGN: {
+      const Node &lval = ast_[n.a];
+      auto it = locals_.find(lval.decl);
+      if (it != locals_.end() && !lval.a) {
+        assign(it->second, n.b);
+        break;
+      }
+      uint32_t addr = lval.a ? element(n.a) : base(lval.decl);
+      f_->emit(IR_STORE, 0, addr, exp(n.b));
+      break;
+    }
+    case N_EXP_STMT:
+      exp(n.a);
+      break;
+    case N_EMPTY:
+      break;
+    case N_IF: {
+      int32_t other = f_->new_label();
+      cond(n.a, 0, other);
+      stmt(n.b);
+      if (n.c) {
+        int32_t end = f_->new_label();
+        jump(end);
+        label(other);
+        stmt(n.c);
+        label(end);
+      } else {
+        label(other);
+      }
+      break;
+    }
+    case N_WHILE: {
+      // The test goes after the body, so an iteration ends in one IF
+      // rather than a GOTO back to it and an IF out.
+      Loop loop{f_->new_label(), f_->new_label()};
+      int32_t body = f_->new_label();
+      jump(loop.next);
+      label(body);
+      loops_.push_back(loop);
+      stmt(n.b);
+      loops_.pop_back();
+      label(loop.next);
+      cond(n.a, body, 0);
+      label(loop.exit);
+      break;
+    }
+    case N_BREAK:
+      jump(loops_.back().exit);
+      break;
+    case N_CONTINUE:
+      jump(loops_.back().next);
+      break;
+    case N_RETURN:
+      f_->emit(IR_RET, 0, n.a ? exp(n.a) : 0);
+      break;
+    default:
+      break;
+  }
+}
+
+void Lowering::var_def(NodeId def) {
+  const Node &n = ast_[def];
+  const int32_t *shape = ast_.shape_of(def);
+  if (shape[0] == 0 && (n.flags & F_CONST)) return;  // every use was folded
+  uint32_t v = local(def);
+  if (shape[0] == 0) {
+    // An uninitialized local holds garbage; zero is as good as any and
+    // keeps ir.py from stopping at a read of an undefined variable.
+    InitRange init = n.b ? ast_.init_of(def) : InitRange{};
+    if (init.size()) assign(v, init.begin()->exp);
+    else f_->emit(IR_LI, v, 0, 0, 0);
+    return;
+  }
+  int64_t size = element_count(shape + 1, shape[0]);
+  f_->emit(IR_DEC, v, 0, 0, size * 4);
+  if (!n.b) return;
+  // DEC memory is not cleared. A few zeros get a store each, more than
+  // that a loop over the whole array; then only the listed elements are
+  // stored.
+  InitRange elems = ast_.init_of(def);
+  auto store = [&](int64_t i, uint32_t value) {
+    uint32_t addr = i ? bini(OP_ADD, v, i * 4) : v;
+    f_->emit(IR_STORE, 0, addr, value);
+  };
+  if (size - int64_t(elems.size()) > max_zero_stores) {
+    zero_fill(v, size);
+    for (const InitElem &e : elems) store(e.index, exp(e.exp));
+    return;
+  }
+  const InitElem *e = elems.begin();
+  for (int64_t i = 0; i < size; i++) store(i, e != elems.end() && e->index == i ? exp((e++)->exp) : li(0));
+}
+
+// Store 0 to the `size` words at `base`:
+//   p = base; end = p + size*4
+//   LABEL loop: *p = 0; p = p + 4; IF p < end GOTO loop
+void Lowering::zero_fill(uint32_t base, int64_t size) {
+  uint32_t p = f_->new_temp();
+  f_->emit(IR_MOV, p, base);
+  uint32_t end = bini(OP_ADD, p, size * 4);
+  uint32_t zero = li(0);
+  int32_t loop = f_->new_label();
+  label(loop);
+  f_->emit(IR_STORE, 0, p, zero);
+  f_->emit(IR_BINI, p, p, 0, 4, OP_ADD);
+  f_->emit(IR_IF, 0, p, end, loop, OP_LT);
+}
+
+// dst = e, computing e straight into dst when its last instruction
+// produced a fresh temporary.
+void Lowering::assign(uint32_t dst, NodeId e) {
+  if (ast_[e].flags & F_CONST) {
+    f_->emit(IR_LI, dst, 0, 0, ast_[e].value);
+    return;
+  }
+  size_t before = f_->code.size();
+  uint32_t v = exp(e);
+  IrInst *last = f_->code.size() > before ? &f_->code.back() : nullptr;
+  if (last && last->op != IR_LI && last->dst == v && f_->values[v] == IrFunction::temp &&
+      v == f_->values.size() - 1) {
+    last->dst = dst;
+    f_->values.pop_back();
+  } else {
+    f_->emit(IR_MOV, dst, v);
+  }
+}
+
+uint32_t Lowering::exp(NodeId e) {
+  const Node &n = ast_[e];
+  if (n.flags & F_CONST) return li(n.value);
+  switch (n.kind) {
+    case N_LVAL: {
+      if (n.a || n.type == T_ARRAY) {
+        uint32_t addr = element(e);
+        return n.type == T_ARRAY ? addr : load(addr);
+      }
+      auto it = locals_.find(n.decl);
+      return it != locals_.end() ? it->second : load(base(n.decl));
+    }
+    case N_CALL:
+      return call(e);
+    case N_UNARY: {
+      if (n.op == OP_NOT) return truth(e);
+      uint32_t a = exp(n.a);
+      if (n.op == OP_POS) return a;
+      uint32_t t = f_->new_temp();
+      f_->emit(IR_NEG, t, a);
+      return t;
+    }
+    case N_BINARY: {
+      return n.op < OP_LT ? arith(n.op, n.a, n.b) : truth(e);
+    }
+    default:
+      return li(n.value);
+  }
+}
+
+// a op b for the arithmetic operators. A constant operand becomes the
+// immediate of a Binaryi when it is on the right, or on the left of a
+// commutative operator.
+uint32_t Lowering::arith(uint8_t op, NodeId a, NodeId b) {
+  if ((op == OP_ADD || op == OP_MUL) && (ast_[a].flags & F_CONST) && !(ast_[b].flags & F_CONST)) {
+    std::swap(a, b);
+  }
+  uint32_t x = exp(a);
+  bool imm = ast_[b].flags & F_CONST;
+  int32_t k = ast_[b].value;
+  uint32_t y = imm ? 0 : exp(b);
+  auto apply = [&](uint8_t o, uint32_t l) { return imm ? bini(o, l, k) : bin(o, l, y); };
+  if (op == OP_MOD) {  // ir.py's % rounds toward -inf, C's toward 0
+    return bin(OP_SUB, x, apply(OP_MUL, apply(OP_DIV, x)));
+  }
+  return apply(op, x);
+}
+
+uint32_t Lowering::call(NodeId e) {
+  const Node &n = ast_[e];
+  // Arguments are all evaluated before the first ARG, since a call inside
+  // one of them would take the ARGs pushed so far.
+  std::vector<uint32_t> args;
+  for (NodeId arg = n.a; arg; arg = ast_[arg].next) args.push_back(exp(arg));
+  for (uint32_t a : args) f_->emit(IR_ARG, 0, a);
+  uint32_t dst = ast_[n.decl].flags & F_VOID ? 0 : f_->new_temp();
+  f_->emit(IR_CALL, dst, 0, 0, n.name);
+  return dst;
+}
+
+// Value 1 or 0 of a condition used as an integer.
+uint32_t Lowering::truth(NodeId e) {
+  uint32_t t = f_->new_temp();
+  int32_t done = f_->new_label();
+  f_->emit(IR_LI, t, 0, 0, 0);
+  cond(e, 0, done);
+  f_->emit(IR_LI, t, 0, 0, 1);
+  label(done);
+  return t;
+}
+
+// Address of the first element of an array, or of a global scalar.
+uint32_t Lowering::base(NodeId decl) {
+  auto it = locals_.find(decl);
+  if (it != locals_.end()) return it->second;
+  uint32_t t = f_->new_temp();
+  f_->emit(IR_LA, t, 0, 0, ast_[decl].name);
+  return t;
+}
+
+// Address of the element or sub-array an indexed N_LVAL names.
+uint32_t Lowering::element(NodeId lval) {
+  const Node &n = ast_[lval];
+  const int32_t *shape = ast_.shape_of(n.decl);
+  uint32_t addr = base(n.decl);
+  int64_t stride = 4 * element_count(shape + 2, shape[0] - 1);
+  uint32_t offset = 0;     // sum of the non-constant indices, scaled
+  int64_t fixed = 0;       // and of the constant ones
+  int k = 0;
+  for (NodeId i = n.a; i; i = ast_[i].next, k++) {
+    if (ast_[i].flags & F_CONST) {
+      fixed += ast_[i].value * stride;
+    } else {
+      uint32_t scaled = bini(OP_MUL, exp(i), stride);
+      offset = offset ? bin(OP_ADD, offset, scaled) : scaled;
+    }
+    if (k + 1 < shape[0]) stride /= shape[2 + k];
+  }
+  if (offset) addr = bin(OP_ADD, addr, offset);
+  return fixed ? bini(OP_ADD, addr, fixed) : addr;
+}
+
+// Jump to `yes` if e is true and to `no` if it is false, where one of the
+// two may be 0 for "fall through". && and || become chains of IFs into
+// these labels, so the right operand is skipped without a 0/1 value ever
+// being computed, and a comparison is a single IF.
+void Lowering::cond(NodeId e, int32_t yes, int32_t no) {
+  const Node &n = ast_[e];
+  if (n.flags & F_CONST) {
+    if (n.value ? yes : no) jump(n.value ? yes : no);
+    return;
+  }
+  if (n.kind == N_UNARY && n.op == OP_NOT) {
+    cond(n.a, no, yes);
+    return;
+  }
+  if (n.kind == N_BINARY && (n.op == OP_AND || n.op == OP_OR)) {
+    bool is_and = n.op == OP_AND;
+    int32_t skip = is_and ? no : yes;  // where the left operand decides
+    int32_t out = skip ? skip : f_->new_label();
+    if (is_and) cond(n.a, 0, out);
+    else cond(n.a, out, 0);
+    cond(n.b, yes, no);
+    if (!skip) label(out);
+    return;
+  }
+  uint8_t op = OP_NE;
+  uint32_t a, b;
+  if (n.kind == N_BINARY && n.op >= OP_LT) {
+    op = n.op;
+    a = exp(n.a);
+    b = exp(n.b);
+  } else {
+    a = exp(e);
+    b = li(0);
+  }
+  if (yes) {
+    f_->emit(IR_IF, 0, a, b, yes, op);
+    if (no) jump(no);
+  } else {
+    f_->emit(IR_IF, 0, a, b, no, ir_negate(op));
+  }
+}
+
+void lower_function(const Unit &unit, NodeId func, std::string &out) {
+  IrFunction f;
+  Lowering(unit, func).run(f);
+  Cfg cfg(f);
+  to_ssa(cfg, DomTree(cfg));
+  propagate_constants(cfg);
+  number_values(cfg, DomTree(cfg));
+  hoist_invariants(cfg);
+  remove_dead_code(cfg);
+  from_ssa(cfg, DomTree(cfg));
+  cfg.flatten();
+  print_ir(f, unit.names, out);
+}
+
+// GLOBAL g: followed by one .WORD per element. ir.py has no directive
+// for a run of zeros, so an uninitialized or sparse table still takes a
+// line per word; those lines are at least appended without formatting.
+void emit_global(const Unit &unit, NodeId def, std::string &out) {
+  const Ast &ast = unit.ast;
+  const int32_t *shape = ast.shape_of(def);
+  int64_t size = element_count(shape + 1, shape[0]);
+  InitRange elems = ast[def].b ? ast.init_of(def) : InitRange{};
+  const InitElem *e = elems.begin();
+  out += "GLOBAL " + unit.names[ast[def].name] + ":\n";
+  for (int64_t i = 0; i < size; i++) {
+    if (e == elems.end() || e->index != i) {
+      out += "  .WORD #0\n";
+      continue;
+    }
+    char buf[16];
+    out += "  .WORD #";
+    out.append(buf, std::to_chars(buf, buf + sizeof buf, ast[(e++)->exp].value).ptr);
+    out += '\n';
+  }
+}
+
+}  // namespace
+
+void generate_ir(const Ast &ast, WorkPool &pool, std::string &out) {
+  Unit unit{ast, {}, std::vector<char>(ast.names.size())};
+  unit.names.reserve(ast.names.size());
+  for (uint32_t id = 0; id < ast.names.size(); id++) unit.names.push_back(ir_name(ast.names.str(id)));
+
+  std::vector<NodeId> funcs;
+  for (NodeId item = ast[ast.root].a; item; item = ast[item].next) {
+    if (ast[item].kind == N_FUNC_DEF) {
+      unit.global[ast[item].name] = 1;
+      funcs.push_back(item);
+      continue;
+    }
+    for (NodeId def = ast[item].a; def; def = ast[def].next) {
+      unit.global[ast[def].name] = 1;
+      if (ast.shape_of(def)[0] > 0 || !(ast[def].flags & F_CONST)) emit_global(unit, def, out);
+    }
+  }
+  std::vector<std::string> bodies(funcs.size());
+  pool.run(funcs.size(), [&](size_t i) { lower_function(unit, funcs[i], bodies[i]); });
+  for (const std::string &body : bodies) out += body;
+}
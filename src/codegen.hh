@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+#include "ast.hh"
+
+class WorkPool;
+
+// Translation of a checked Ast into the textual IR that ir.py runs.
+//
+// Global data is emitted first, on the calling thread. Each function is
+// then lowered to three-address code (ir.hh) on `pool`, optimized in SSA
+// form (opt.hh) and printed into a buffer of its own, reading the tree but
+// never changing it; the buffers are appended to `out` in source order.
+// The output is therefore the same byte for byte whatever the number of
+// threads.
+void generate_ir(const Ast &ast, WorkPool &pool, std::string &out);
@@ -0,0 +1,158 @@
+#include "ast.hh"
+#include "cfg.hh"
+#include "opt.hh"
+
+namespace {
+
+typedef std::pair<uint32_t, uint32_t> Site;  // block, index
+
+// Whether each value may be an address something reads through. Only
+// addresses into an array from DEC can be told apart: the array is never
+// read if no LOAD reads through an address into it and no such address
+// leaves the function or is stored, and then every STORE into it is dead.
+std::vector<char> readable(Cfg &cfg) {
+  uint32_t values = cfg.f.values.size();
+  std::vector<uint32_t> array(values);  // DEC value an address points into
+  std::vector<char> read(values);
+  bool any = false;
+  for (const Block &block : cfg.blocks) {
+    for (const IrInst &i : block.code) {
+      if (i.op == IR_DEC) array[i.dst] = i.dst, any = true;
+    }
+  }
+  if (!any) return std::vector<char>(values, 1);
+
+  // Addresses flow through copies, pointer arithmetic and phis, around
+  // loops too, so repeat until nothing changes.
+  auto derive = [&](uint32_t dst, uint32_t from) {
+    if (!from || array[dst] == from) return false;
+    if (array[dst]) {
+      read[array[dst]] = read[from] = 1;
+      return false;
+    }
+    array[dst] = from;
+    return true;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (Block &block : cfg.blocks) {
+      for (IrInst &i : block.code) {
+        switch (i.op) {
+          case IR_MOV:
+            changed |= derive(i.dst, array[i.a]);
+            break;
+          case IR_BINI:
+            if (i.sub == OP_ADD || i.sub == OP_SUB) changed |= derive(i.dst, array[i.a]);
+            break;
+          case IR_BIN:
+            if (i.sub == OP_ADD || i.sub == OP_SUB) changed |= derive(i.dst, array[i.a]);
+            if (i.sub == OP_ADD) changed |= derive(i.dst, array[i.b]);
+            break;
+          case IR_PHI: {
+            const uint32_t *args = cfg.phi_args(i);
+            for (size_t k = 0; k < block.preds.size(); k++) changed |= derive(i.dst, array[args[k]]);
+            break;
+          }
+          default:
+            break;
+        }
+      }
+    }
+  }
+
+  for (Block &block : cfg.blocks) {
+    for (IrInst &i : block.code) {
+      uint32_t *ops[2];
+      int count = ir_uses(i, ops);
+      for (int k = 0; k < count; k++) {
+        uint32_t a = array[*ops[k]];
+        if (!a) continue;
+        bool address = (i.op == IR_STORE && k == 0) || i.op == IR_IF || i.op == IR_MOV ||
+                       (i.op == IR_BINI && (i.sub == OP_ADD || i.sub == OP_SUB)) ||
+                       (i.op == IR_BIN && i.sub == OP_ADD) || (i.op == IR_BIN && i.sub == OP_SUB && k == 0);
+        if (!address) read[a] = 1;
+      }
+    }
+  }
+  for (uint32_t v = 0; v < values; v++) read[v] = !array[v] || read[array[v]];
+  return read;
+}
+
+}  // namespace
+
+void remove_dead_code(Cfg &cfg) {
+  uint32_t values = cfg.f.values.size();
+  std::vector<char> read = readable(cfg);
+
+  // A STORE is dead if its array is never read, or if a later STORE in
+  // the same block writes the same address with no LOAD or CALL between.
+  std::vector<uint32_t> stored(values);
+  std::vector<char> dead;
+  uint32_t epoch = 0;
+  for (Block &block : cfg.blocks) {
+    std::vector<IrInst> &code = block.code;
+    dead.assign(code.size(), 0);
+    epoch++;
+    for (size_t n = code.size(); n-- > 0;) {
+      const IrInst &i = code[n];
+      if (i.op == IR_LOAD || i.op == IR_CALL) epoch++;
+      if (i.op != IR_STORE) continue;
+      dead[n] = !read[i.a] || stored[i.a] == epoch;
+      stored[i.a] = epoch;
+    }
+    size_t out = 0;
+    for (size_t n = 0; n < code.size(); n++) {
+      if (!dead[n]) code[out++] = code[n];
+    }
+    code.resize(out);
+  }
+
+  // Mark what the effects of the function need, from the instructions
+  // that have effects back through the assignments of their operands.
+  std::vector<Site> def(values);
+  std::vector<char> live(values);
+  std::vector<uint32_t> work;
+  auto use = [&](uint32_t v) {
+    if (!live[v]) {
+      live[v] = 1;
+      work.push_back(v);
+    }
+  };
+  auto effect = [&](const IrInst &i) {
+    switch (i.op) {
+      case IR_GOTO: case IR_IF: case IR_STORE: case IR_PARAM: case IR_ARG: case IR_CALL: case IR_RET:
+        return true;
+      default:
+        return false;
+    }
+  };
+  auto mark = [&](IrInst &i, uint32_t b) {
+    uint32_t *ops[2];
+    for (int k = ir_uses(i, ops); k-- > 0;) use(*ops[k]);
+    if (i.op != IR_PHI) return;
+    const uint32_t *args = cfg.phi_args(i);
+    for (size_t k = 0; k < cfg.blocks[b].preds.size(); k++) use(args[k]);
+  };
+  for (uint32_t b = 0; b < cfg.blocks.size(); b++) {
+    std::vector<IrInst> &code = cfg.blocks[b].code;
+    for (uint32_t n = 0; n < code.size(); n++) {
+      if (ir_defines(code[n])) def[code[n].dst] = {b, n};
+      if (effect(code[n])) mark(code[n], b);
+    }
+  }
+  while (!work.empty()) {
+    uint32_t v = work.back();
+    work.pop_back();
+    IrInst &i = cfg.blocks[def[v].first].code[def[v].second];
+    if (!effect(i)) mark(i, def[v].first);
+  }
+
+  for (Block &block : cfg.blocks) {
+    size_t out = 0;
+    for (IrInst &i : block.code) {
+      if (i.op == IR_CALL && !live[i.dst]) i.dst = 0;
+      if (effect(i) || live[i.dst]) block.code[out++] = i;
+    }
+    block.code.resize(out);
+  }
+}
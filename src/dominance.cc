@@ -0,0 +1,98 @@
+#include "dominance.hh"
+#include "cfg.hh"
+
+DomTree::DomTree(const Cfg &cfg) {
+  uint32_t n = cfg.blocks.size();
+  const uint32_t none = UINT32_MAX;
+
+  // Postorder by an explicit DFS; functions can be deep enough to
+  // overflow the stack with recursion.
+  std::vector<uint32_t> post(n, none);  // postorder number
+  std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 0}};  // block, next succ
+  std::vector<char> seen(n);
+  seen[0] = 1;
+  uint32_t count = 0;
+  rpo_.resize(n);
+  while (!stack.empty()) {
+    auto &[b, i] = stack.back();
+    const std::vector<uint32_t> &succs = cfg.blocks[b].succs;
+    if (i < succs.size()) {
+      uint32_t s = succs[i++];
+      if (!seen[s]) {
+        seen[s] = 1;
+        stack.push_back({s, 0});
+      }
+      continue;
+    }
+    post[b] = count;
+    rpo_[n - 1 - count] = b;
+    count++;
+    stack.pop_back();
+  }
+
+  idom_.assign(n, none);
+  idom_[0] = 0;
+  auto intersect = [&](uint32_t a, uint32_t b) {
+    while (a != b) {
+      while (post[a] < post[b]) a = idom_[a];
+      while (post[b] < post[a]) b = idom_[b];
+    }
+    return a;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (uint32_t b : rpo_) {
+      if (b == 0) continue;
+      uint32_t d = none;
+      for (uint32_t p : cfg.blocks[b].preds) {
+        if (idom_[p] == none) continue;
+        d = d == none ? p : intersect(p, d);
+      }
+      if (d != idom_[b]) {
+        idom_[b] = d;
+        changed = true;
+      }
+    }
+  }
+
+  child_start_.assign(n + 2, 0);
+  for (uint32_t b = 1; b < n; b++) child_start_[idom_[b] + 2]++;
+  for (uint32_t b = 0; b < n; b++) child_start_[b + 2] += child_start_[b + 1];
+  children_.resize(n > 0 ? n - 1 : 0);
+  for (uint32_t b : rpo_) {
+    if (b != 0) children_[child_start_[idom_[b] + 1]++] = b;
+  }
+  child_start_.pop_back();
+
+  pre_.resize(n);
+  last_.resize(n);
+  preorder_.reserve(n);
+  std::vector<uint32_t> todo{0};
+  while (!todo.empty()) {
+    uint32_t b = todo.back();
+    todo.pop_back();
+    pre_[b] = preorder_.size();
+    preorder_.push_back(b);
+    for (const uint32_t *c = children_end(b); c != children_begin(b);) todo.push_back(*--c);
+  }
+  // a subtree is contiguous in preorder and ends at its last descendant
+  for (uint32_t k = n; k-- > 0;) {
+    uint32_t b = preorder_[k];
+    last_[b] = children_begin(b) == children_end(b) ? pre_[b] : last_[*(children_end(b) - 1)];
+  }
+}
+
+std::vector<std::vector<uint32_t>> DomTree::frontiers(const Cfg &cfg) const {
+  std::vector<std::vector<uint32_t>> df(cfg.blocks.size());
+  for (uint32_t b = 0; b < cfg.blocks.size(); b++) {
+    const std::vector<uint32_t> &preds = cfg.blocks[b].preds;
+    if (preds.size() < 2) continue;
+    for (uint32_t p : preds) {
+      for (uint32_t r = p; r != idom_[b]; r = idom_[r]) {
+        if (!df[r].empty() && df[r].back() == b) break;
+        df[r].push_back(b);
+      }
+    }
+  }
+  return df;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+class Cfg;
+
+// Dominator tree of a Cfg, computed with the iterative algorithm of
+// Cooper, Harvey and Kennedy ("A Simple, Fast Dominance Algorithm"). All
+// blocks of a Cfg are reachable, so every block but the entry has an
+// immediate dominator. The tree goes stale when the Cfg's edges change.
+class DomTree {
+ public:
+  explicit DomTree(const Cfg &cfg);
+
+  uint32_t idom(uint32_t b) const { return idom_[b]; }
+  bool dominates(uint32_t a, uint32_t b) const { return pre_[a] <= pre_[b] && pre_[b] <= last_[a]; }
+
+  // Blocks in reverse postorder of the Cfg: every block comes after its
+  // predecessors, back edges aside.
+  const std::vector<uint32_t> &rpo() const { return rpo_; }
+  // Blocks in preorder of the tree: every block after its dominators.
+  const std::vector<uint32_t> &preorder() const { return preorder_; }
+  // Blocks `b` immediately dominates, as a range.
+  const uint32_t *children_begin(uint32_t b) const { return children_.data() + child_start_[b]; }
+  const uint32_t *children_end(uint32_t b) const { return children_.data() + child_start_[b + 1]; }
+
+  // Dominance frontier of every block: the blocks where its dominance
+  // ends, which is where SSA construction places phis.
+  std::vector<std::vector<uint32_t>> frontiers(const Cfg &cfg) const;
+
+ private:
+  std::vector<uint32_t> idom_, rpo_, preorder_;
+  std::vector<uint32_t> children_, child_start_;
+  std::vector<uint32_t> pre_, last_;  // preorder number, largest in the subtree
+};
@@ -0,0 +1,165 @@
+#include "driver.hh"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ast.hh"
+#include "codegen.hh"
+#include "lexer.hh"
+#include "phase_timer.hh"
+#include "sema.hh"
+#include "source.hh"
+#include "sysy.tab.hh"
+#include "work_pool.hh"
+
+// Dumps of a unit are collected in memory and written in one piece, so
+// units compiled in parallel do not interleave their output.
+static std::mutex stdout_mutex;
+
+// The parser pulls tokens from the scanner, so lexing has no phase of its
+// own. For --time, scan the whole unit once without parsing; the parse
+// phase is then charged only what parsing adds on top of this.
+static void lex_only(Source &src) {
+  Ast scratch;
+  LexExtra extra{&scratch, nullptr};
+  yyscan_t scanner = lex_begin(src.data(), src.size(), &extra);
+  YYSTYPE value;
+  YYLTYPE loc;
+  while (yylex(&value, &loc, scanner)) {
+  }
+  lex_end(scanner);
+}
+
+static size_t count_lines(std::string_view text) {
+  size_t lines = 0;
+  for (char c : text) lines += c == '\n';
+  return lines + (!text.empty() && text.back() != '\n');
+}
+
+static bool write_file(const char *path, const std::string &text) {
+  FILE *fp = fopen(path, "w");
+  bool ok = fp && fwrite(text.data(), 1, text.size(), fp) == text.size();
+  if (fp && fclose(fp) != 0) ok = false;
+  if (!ok) fprintf(stderr, "%s: unable to write output\n", path);
+  return ok;
+}
+
+int compile_file(const char *input, const char *output, const Options &opt) {
+  PhaseTimer timer;
+  Source src;
+  if (!src.open(input)) {
+    fprintf(stderr, "%s: unable to open input\n", input);
+    return 1;
+  }
+  timer.lap("read");
+  double lex_seconds = 0;
+  if (opt.time) {
+    lex_only(src);
+    lex_seconds = timer.lap("lex");
+  }
+  char *dump_text = nullptr;
+  size_t dump_len = 0;
+  FILE *dump = opt.dump_tokens || opt.dump_ast ? open_memstream(&dump_text, &dump_len) : nullptr;
+  Ast ast;
+  Sema sema(ast, !opt.syntax_only);
+  std::unique_ptr<TokenDump> tokens(opt.dump_tokens ? new TokenDump(dump) : nullptr);
+  LexExtra extra{&ast, tokens.get()};
+  yyscan_t scanner = lex_begin(src.data(), src.size(), &extra);
+  int failed = yyparse(scanner, ast, sema) || (sema.errors() && !opt.syntax_only);
+  lex_end(scanner);
+  timer.lap("parse", lex_seconds);
+  if (tokens) {
+    tokens->put("\n", 1);
+    tokens->flush();
+  }
+  if (!failed && opt.dump_ast) ast.dump(dump);
+  if (dump) {
+    fclose(dump);
+    std::lock_guard<std::mutex> lock(stdout_mutex);
+    fwrite(dump_text, 1, dump_len, stdout);
+    free(dump_text);
+  }
+  if (failed) return 1;
+  // Without an output file the IR would only be thrown away; --time still
+  // generates it to measure it.
+  if (!opt.check && !opt.syntax_only && (output || opt.time)) {
+    std::string ir;
+    if (opt.pool) {
+      generate_ir(ast, *opt.pool, ir);
+    } else {
+      WorkPool serial(1);
+      generate_ir(ast, serial, ir);
+    }
+    timer.lap("irgen");
+    if (output && !write_file(output, ir)) return 1;
+  }
+  timer.lap("write");
+  if (opt.time) {
+    std::lock_guard<std::mutex> lock(stdout_mutex);
+    timer.report(stderr, input, count_lines(src.text()), src.size());
+  }
+  return 0;
+}
+
+int compile_files(const std::vector<Job> &jobs, const Options &opt) {
+  std::vector<char> failed(jobs.size());
+  WorkPool pool(opt.jobs);
+  // With several files each one is a task and its functions are lowered
+  // inline; a single file spreads its functions over the pool instead.
+  Options unit_opt = opt;
+  unit_opt.pool = &pool;
+  pool.run(jobs.size(), [&](size_t i) {
+    const Job &job = jobs[i];
+    failed[i] = compile_file(job.input.c_str(), job.output.empty() ? nullptr : job.output.c_str(), unit_opt);
+  });
+  int nfailed = 0;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (failed[i]) {
+      fprintf(stderr, "%s: compilation failed\n", jobs[i].input.c_str());
+      nfailed++;
+    }
+  }
+  if (nfailed) fprintf(stderr, "%d of %zu files failed\n", nfailed, jobs.size());
+  return nfailed != 0;
+}
+
+static bool read_jobs(const char *list, std::vector<Job> &jobs) {
+  Source src;
+  if (!src.open(list)) return false;
+  std::string_view text = src.text();
+  while (!text.empty()) {
+    size_t eol = text.find('\n');
+    std::string_view line = text.substr(0, eol);
+    text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+    std::string_view fields[2];
+    size_t n = 0, i = 0;
+    while (n < 2) {
+      while (i < line.size() && isspace((unsigned char)line[i])) i++;
+      if (i == line.size()) break;
+      size_t start = i;
+      while (i < line.size() && !isspace((unsigned char)line[i])) i++;
+      fields[n++] = line.substr(start, i - start);
+    }
+    if (n && fields[0][0] != '#') jobs.push_back(Job{std::string(fields[0]), std::string(fields[1])});
+  }
+  return true;
+}
+
+int compile_batch(const char *list, const Options &opt) {
+  std::vector<Job> jobs;
+  if (!read_jobs(list, jobs)) {
+    fprintf(stderr, "%s: unable to open batch list\n", list);
+    return 1;
+  }
+  return compile_files(jobs, opt);
+}
+
+std::string default_output(const std::string &input) {
+  size_t slash = input.rfind('/');
+  size_t dot = input.rfind('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return input + ".ir";
+  return input.substr(0, dot) + ".ir";
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+
+class WorkPool;
+
+// Compiler driver: runs source files through the front end and writes the
+// results, one file at a time or several on a thread pool.
+
+struct Options {
+  bool dump_tokens = false;  // trace tokens to stdout
+  bool dump_ast = false;     // print the tree to stdout
+  bool check = false;        // stop after parsing and semantic checks
+  bool syntax_only = false;  // check only; ignore semantic errors
+  bool time = false;         // report time per phase to stderr
+  unsigned jobs = 1;         // threads for multi-file compilation
+  WorkPool *pool = nullptr;  // threads to lower functions on; null: serial
+};
+
+struct Job {
+  std::string input;
+  std::string output;  // empty: no output file
+};
+
+// Compile `input` and write the output to `output`, if given. Diagnostics
+// go to stderr. Returns 0 on success and 1 if the file is rejected.
+// Units share no state, so this may run on several threads at once.
+int compile_file(const char *input, const char *output, const Options &opt);
+
+// Compile every job on `opt.jobs` threads. A failed job does not stop the
+// rest; the failures are listed at the end. Returns 0 if every job
+// succeeded and 1 otherwise.
+int compile_files(const std::vector<Job> &jobs, const Options &opt);
+
+// Compile every job listed in the file at `list`, one per line as
+// `input [output]`; blank lines and lines starting with '#' are skipped.
+int compile_batch(const char *list, const Options &opt);
+
+// Output path for `input` when none is given: its extension becomes .ir.
+std::string default_output(const std::string &input);
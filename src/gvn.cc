@@ -0,0 +1,176 @@
+#include <algorithm>
+#include "ast.hh"
+#include "cfg.hh"
+#include "dominance.hh"
+#include "opt.hh"
+
+namespace {
+
+// What an instruction computes, without where it puts it. A LOAD's `b`
+// is the memory generation it reads.
+struct Expr {
+  IrOp op;
+  uint8_t sub;
+  uint32_t a, b;
+  int32_t imm;
+
+  bool operator==(const Expr &e) const {
+    return op == e.op && sub == e.sub && a == e.a && b == e.b && imm == e.imm;
+  }
+};
+
+// Expressions available at the current point of the walk, in an
+// open-addressing table with linear probing over a stack of entries.
+// Entries leave in the reverse of the order they came in, so a slot can
+// simply be cleared: nothing placed after it is left to probe past it.
+class ExprTable {
+ public:
+  ExprTable() : slots_(1024), mask_(1023) {}
+
+  // The value of `e`, after making it `v` if it has none yet.
+  uint32_t insert(const Expr &e, uint32_t v) {
+    uint32_t h = hash_of(e);
+    for (uint32_t i = h & mask_;; i = (i + 1) & mask_) {
+      uint32_t slot = slots_[i];
+      if (slot == 0) {
+        entries_.push_back(Entry{e, v, h});
+        slots_[i] = entries_.size();
+        if (entries_.size() * 2 > slots_.size()) grow();
+        return v;
+      }
+      const Entry &entry = entries_[slot - 1];
+      if (entry.hash == h && entry.expr == e) return entry.value;
+    }
+  }
+
+  size_t size() const { return entries_.size(); }
+  // Forget the entries made since size() was `n`.
+  void pop_to(size_t n) {
+    for (; entries_.size() > n; entries_.pop_back()) {
+      uint32_t i = entries_.back().hash & mask_;
+      while (slots_[i] != entries_.size()) i = (i + 1) & mask_;
+      slots_[i] = 0;
+    }
+  }
+
+ private:
+  struct Entry {
+    Expr expr;
+    uint32_t value, hash;
+  };
+
+  static uint32_t hash_of(const Expr &e) {
+    uint64_t h = (uint64_t(e.op) << 8 | e.sub) * 0x9e3779b97f4a7c15u;
+    h = (h ^ e.a) * 0x9e3779b97f4a7c15u;
+    h = (h ^ e.b) * 0x9e3779b97f4a7c15u;
+    h = (h ^ uint32_t(e.imm)) * 0x9e3779b97f4a7c15u;
+    return h >> 32;
+  }
+
+  // Double the table at half load and reinsert in entry order.
+  void grow() {
+    std::vector<uint32_t> slots(slots_.size() * 2);
+    mask_ = slots.size() - 1;
+    for (uint32_t id = 0; id < entries_.size(); id++) {
+      uint32_t i = entries_[id].hash & mask_;
+      while (slots[i]) i = (i + 1) & mask_;
+      slots[i] = id + 1;
+    }
+    slots_.swap(slots);
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> slots_;  // entry + 1, 0 for an empty slot
+  uint32_t mask_;
+};
+
+}  // namespace
+
+void number_values(Cfg &cfg, const DomTree &dom) {
+  uint32_t values = cfg.f.values.size();
+  std::vector<uint32_t> leader(values);
+  for (uint32_t v = 0; v < values; v++) leader[v] = v;
+  ExprTable available;
+  std::vector<std::pair<uint32_t, size_t>> scopes;  // block, table size on entry
+  std::vector<uint32_t> generation_out(cfg.blocks.size());
+  uint32_t generations = 0;
+
+  for (uint32_t b : dom.preorder()) {
+    while (!scopes.empty() && scopes.back().first != dom.idom(b)) {
+      available.pop_to(scopes.back().second);
+      scopes.pop_back();
+    }
+    scopes.push_back({b, available.size()});
+    Block &block = cfg.blocks[b];
+    // Memory is only known to be unchanged since the dominator's end when
+    // the dominator is the one way in.
+    uint32_t generation = block.preds.size() == 1 ? generation_out[block.preds[0]] : ++generations;
+
+    size_t out = 0;
+    for (IrInst &i : block.code) {
+      uint32_t *ops[2];
+      for (int k = ir_uses(i, ops); k-- > 0;) *ops[k] = leader[*ops[k]];
+      uint32_t same = 0;  // a value i always equals
+      Expr e{i.op, i.sub, i.a, i.b, i.imm};
+      switch (i.op) {
+        case IR_PHI: {
+          // A phi choosing between one value and itself is that value.
+          const uint32_t *args = cfg.phi_args(i);
+          for (size_t k = 0; k < block.preds.size() && same != UINT32_MAX; k++) {
+            uint32_t v = leader[args[k]];
+            if (v != i.dst && v != same) same = same ? UINT32_MAX : v;
+          }
+          if (same == UINT32_MAX) same = 0;
+          break;
+        }
+        case IR_MOV:
+          same = i.a;
+          break;
+        case IR_BIN:
+          if ((i.sub == OP_ADD || i.sub == OP_MUL) && e.a > e.b) std::swap(e.a, e.b);
+          break;
+        case IR_BINI:
+          if (i.imm == 0 && (i.sub == OP_ADD || i.sub == OP_SUB)) same = i.a;
+          if (i.imm == 1 && (i.sub == OP_MUL || i.sub == OP_DIV)) same = i.a;
+          break;
+        case IR_STORE:
+          // A load right after the store reads what was stored.
+          generation = ++generations;
+          available.insert(Expr{IR_LOAD, 0, i.a, generation, 0}, i.b);
+          break;
+        case IR_CALL:
+          generation = ++generations;
+          break;
+        case IR_LOAD:
+          e.b = generation;
+          break;
+        default:
+          break;
+      }
+      // An LI is left alone: it costs no more than the copy from_ssa may
+      // need once its value is shared with a variable assigned again later.
+      bool pure = i.op == IR_BIN || i.op == IR_BINI || i.op == IR_NEG || i.op == IR_LA ||
+                  i.op == IR_LOAD;
+      if (!same && pure) {
+        uint32_t v = available.insert(e, i.dst);
+        if (v != i.dst) same = v;
+      }
+      if (same) {
+        leader[i.dst] = same;
+        continue;
+      }
+      block.code[out++] = i;
+    }
+    block.code.resize(out);
+    generation_out[b] = generation;
+  }
+
+  // Phi operands can come from blocks visited after the phi.
+  for (Block &block : cfg.blocks) {
+    for (IrInst &i : block.code) {
+      if (i.op != IR_PHI) break;
+      uint32_t *args = cfg.phi_args(i);
+      for (size_t k = 0; k < block.preds.size(); k++) args[k] = leader[args[k]];
+    }
+  }
+}
@@ -0,0 +1,38 @@
+#include "interner.hh"
+#include <string.h>
+
+static uint32_t hash_of(const char *s, size_t n) {
+  uint32_t h = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+  return h;
+}
+
+Interner::Interner() : arena_(64 * 1024), slots_(1024), mask_(1023) {}
+
+uint32_t Interner::intern(const char *s, size_t n) {
+  uint32_t h = hash_of(s, n);
+  for (uint32_t i = h & mask_;; i = (i + 1) & mask_) {
+    uint32_t slot = slots_[i];
+    if (slot == 0) {
+      uint32_t id = entries_.size();
+      entries_.push_back(Entry{arena_.strdup(s, n), (uint32_t)n, h});
+      slots_[i] = id + 1;
+      if (entries_.size() * 2 > slots_.size()) grow();
+      return id;
+    }
+    const Entry &e = entries_[slot - 1];
+    if (e.hash == h && e.len == n && memcmp(e.str, s, n) == 0) return slot - 1;
+  }
+}
+
+// Double the table at half load and reinsert by the stored hashes.
+void Interner::grow() {
+  std::vector<uint32_t> slots(slots_.size() * 2);
+  mask_ = slots.size() - 1;
+  for (uint32_t id = 0; id < entries_.size(); id++) {
+    uint32_t i = entries_[id].hash & mask_;
+    while (slots[i]) i = (i + 1) & mask_;
+    slots[i] = id + 1;
+  }
+  slots_.swap(slots);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "arena.hh"
+
+// String interner for identifiers. Every distinct spelling gets a small,
+// stable 32-bit ID in order of first appearance, so later stages compare
+// and index by integer instead of by string. Spellings are copied into an
+// arena and stay valid as long as the interner.
+//
+// Lookup is an open-addressing table of IDs with linear probing; the hash
+// of every entry is kept so growing the table never rehashes strings.
+class Interner {
+ public:
+  Interner();
+
+  uint32_t intern(const char *s, size_t n);
+  const char *str(uint32_t id) const { return entries_[id].str; }
+  uint32_t length(uint32_t id) const { return entries_[id].len; }
+  uint32_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    const char *str;
+    uint32_t len;
+    uint32_t hash;
+  };
+
+  void grow();
+
+  Arena arena_;
+  std::vector<Entry> entries_;  // indexed by ID
+  std::vector<uint32_t> slots_;  // ID + 1, 0 for an empty slot
+  uint32_t mask_;
+};
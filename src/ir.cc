@@ -0,0 +1,108 @@
+#include "ir.hh"
+#include <charconv>
+#include "ast.hh"
+
+namespace {
+
+const char *const op_text[] = {
+  "+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=",
+};
+
+class Printer {
+ public:
+  Printer(const IrFunction &f, const std::vector<std::string> &names, std::string &out)
+      : f_(f), names_(names), out_(out) {}
+
+  void num(int64_t n) {
+    char buf[24];
+    out_.append(buf, std::to_chars(buf, buf + sizeof buf, n).ptr);
+  }
+  void value(uint32_t v) {
+    if (f_.values[v] == IrFunction::temp) {
+      out_ += 't';
+      num(v);
+    } else {
+      out_ += names_[f_.values[v]];
+    }
+  }
+  void label(int32_t l) {
+    out_ += 'L';
+    num(l);
+  }
+  void imm(int32_t i) {
+    out_ += '#';
+    num(i);
+  }
+
+  void inst(const IrInst &i) {
+    if (i.op != IR_LABEL) out_ += "  ";
+    switch (i.op) {
+      case IR_LABEL: out_ += "LABEL "; label(i.imm); out_ += ':'; break;
+      case IR_GOTO: out_ += "GOTO "; label(i.imm); break;
+      case IR_IF:
+        out_ += "IF "; value(i.a); out_ += ' '; out_ += op_text[i.sub]; out_ += ' '; value(i.b);
+        out_ += " GOTO "; label(i.imm);
+        break;
+      case IR_MOV: value(i.dst); out_ += " = "; value(i.a); break;
+      case IR_LI: value(i.dst); out_ += " = "; imm(i.imm); break;
+      case IR_BIN:
+        value(i.dst); out_ += " = "; value(i.a); out_ += ' '; out_ += op_text[i.sub]; out_ += ' '; value(i.b);
+        break;
+      case IR_BINI:
+        value(i.dst); out_ += " = "; value(i.a); out_ += ' '; out_ += op_text[i.sub]; out_ += ' '; imm(i.imm);
+        break;
+      case IR_NEG: value(i.dst); out_ += " = - "; value(i.a); break;
+      case IR_LOAD: value(i.dst); out_ += " = *"; value(i.a); break;
+      case IR_STORE: out_ += '*'; value(i.a); out_ += " = "; value(i.b); break;
+      case IR_LA: value(i.dst); out_ += " = &"; out_ += names_[i.imm]; break;
+      case IR_DEC: out_ += "DEC "; value(i.dst); out_ += ' '; imm(i.imm); break;
+      case IR_PARAM: out_ += "PARAM "; value(i.dst); break;
+      case IR_ARG: out_ += "ARG "; value(i.a); break;
+      case IR_CALL:
+        if (i.dst) {
+          value(i.dst);
+          out_ += " = ";
+        }
+        out_ += "CALL ";
+        out_ += names_[i.imm];
+        break;
+      case IR_RET:
+        out_ += "RETURN";
+        if (i.a) {
+          out_ += ' ';
+          value(i.a);
+        }
+        break;
+      case IR_PHI:  // not in ir.py; only seen when debugging a Cfg
+        value(i.dst); out_ += " = PHI "; value(i.b);
+        break;
+    }
+    out_ += '\n';
+  }
+
+ private:
+  const IrFunction &f_;
+  const std::vector<std::string> &names_;
+  std::string &out_;
+};
+
+}  // namespace
+
+uint8_t ir_negate(uint8_t op) {
+  switch (op) {
+    case OP_LT: return OP_GE;
+    case OP_GT: return OP_LE;
+    case OP_LE: return OP_GT;
+    case OP_GE: return OP_LT;
+    case OP_EQ: return OP_NE;
+    default: return OP_EQ;
+  }
+}
+
+void print_ir(const IrFunction &f, const std::vector<std::string> &names, std::string &out) {
+  out += "FUNCTION ";
+  out += names[f.name];
+  out += ":\n";
+  Printer p(f, names, out);
+  for (const IrInst &i : f.code) p.inst(i);
+}
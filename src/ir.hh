@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Three-address code of one function, one record per ir.py instruction.
+//
+// Operands are values: small integers local to the function that print
+// either as the source variable they stand for or as a temporary `t<N>`.
+// Value 0 means "none". Labels are numbered per function and print as
+// `L<N>`; functions and globals are referred to by interned name.
+enum IrOp : uint8_t {
+  IR_LABEL,  // LABEL L<imm>:
+  IR_GOTO,   // GOTO L<imm>
+  IR_IF,     // IF a <sub> b GOTO L<imm>
+  IR_MOV,    // dst = a
+  IR_LI,     // dst = #imm
+  IR_BIN,    // dst = a <sub> b
+  IR_BINI,   // dst = a <sub> #imm
+  IR_NEG,    // dst = - a
+  IR_LOAD,   // dst = *a
+  IR_STORE,  // *a = b
+  IR_LA,     // dst = &<global imm>
+  IR_DEC,    // DEC dst #imm, imm in bytes
+  IR_PARAM,  // PARAM dst
+  IR_ARG,    // ARG a
+  IR_CALL,   // [dst =] CALL <function imm>
+  IR_RET,    // RETURN [a]
+  IR_PHI,    // dst = phi(...), only inside a Cfg (cfg.hh)
+};
+
+struct IrInst {
+  IrOp op;
+  uint8_t sub;   // Op of IR_BIN, IR_BINI and IR_IF
+  uint32_t dst, a, b;
+  int32_t imm;   // immediate, size, label or interned name, see IrOp
+};
+
+// Pointers to the operands `i` reads (an IR_PHI's are in its Cfg), in
+// `ops`; returns how many there are.
+inline int ir_uses(IrInst &i, uint32_t *ops[2]) {
+  switch (i.op) {
+    case IR_IF: case IR_BIN: case IR_STORE:
+      ops[0] = &i.a;
+      ops[1] = &i.b;
+      return 2;
+    case IR_MOV: case IR_BINI: case IR_NEG: case IR_LOAD: case IR_ARG:
+      ops[0] = &i.a;
+      return 1;
+    case IR_RET:
+      ops[0] = &i.a;
+      return i.a != 0;
+    default:
+      return 0;
+  }
+}
+
+// Whether `i` assigns its dst.
+inline bool ir_defines(const IrInst &i) {
+  switch (i.op) {
+    case IR_MOV: case IR_LI: case IR_BIN: case IR_BINI: case IR_NEG: case IR_LOAD:
+    case IR_LA: case IR_DEC: case IR_PARAM: case IR_PHI:
+      return true;
+    case IR_CALL:
+      return i.dst != 0;
+    default:
+      return false;
+  }
+}
+
+// The comparison Op that holds exactly when `op` does not.
+uint8_t ir_negate(uint8_t op);
+
+struct IrFunction {
+  static constexpr uint32_t temp = UINT32_MAX;
+
+  uint32_t name = 0;                  // interned
+  std::vector<IrInst> code;
+  std::vector<uint32_t> values{temp};  // interned name of each value, or temp
+  int32_t labels = 0;
+
+  uint32_t new_temp() {
+    values.push_back(temp);
+    return values.size() - 1;
+  }
+  uint32_t new_named(uint32_t name) {
+    values.push_back(name);
+    return values.size() - 1;
+  }
+  int32_t new_label() { return ++labels; }
+
+  void emit(IrOp op, uint32_t dst, uint32_t a = 0, uint32_t b = 0, int32_t imm = 0, uint8_t sub = 0) {
+    code.push_back(IrInst{op, sub, dst, a, b, imm});
+  }
+};
+
+// Append `f` as ir.py text; `names` gives the IR spelling of every
+// interned name.
+void print_ir(const IrFunction &f, const std::vector<std::string> &names, std::string &out);
@@ -0,0 +1,742 @@
+#include "irvm.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The interpreter follows ir.py closely: same instruction set, same address
+// layout for arrays (starting at 0x1000, 4 bytes per word), same operator
+// semantics (`/` truncates, `%` takes the sign of the divisor like Python),
+// same calling convention (ARG pushes, PARAM pops from the front, `write`
+// prints its first argument). Errors that make ir.py raise an exception make
+// the interpreter exit with status 1.
+
+namespace {
+
+typedef long long word;
+
+struct VmError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] void fail(const std::string &msg) { throw VmError(msg); }
+
+// ---------------------------------------------------------- instructions --
+
+enum Kind {
+  I_LABEL, I_GOTO, I_IF, I_ASSIGN, I_UNARY, I_STORE, I_DEREF, I_BINARY,
+  I_BINARYI, I_LI, I_PARAM, I_ARG, I_RETURN, I_CALL, I_FUNCTION, I_DEC,
+  I_LA, I_GLOBAL, I_WORD,
+};
+
+// Names are views into the IR text, which outlives the Machine.
+struct Inst {
+  Kind kind;
+  std::string_view op;   // operator of UNARY/BINARY/BINARYI/IF
+  std::string_view dst;  // destination, or the only name operand
+  std::string_view a, b;
+  word imm = 0;
+};
+
+// ---------------------------------------------------------------- reader --
+
+enum Keyword { K_NONE = -1, K_LABEL, K_GOTO, K_IF, K_PARAM, K_ARG, K_RETURN, K_CALL, K_FUNCTION, K_DEC, K_GLOBAL };
+
+const char *const keywords[] = {
+  "LABEL", "GOTO", "IF", "PARAM", "ARG", "RETURN", "CALL", "FUNCTION", "DEC", "GLOBAL",
+};
+
+Keyword keyword_of(std::string_view name) {
+  if (name[0] < 'A' || name[0] > 'Z') return K_NONE;
+  for (int i = 0; i <= K_GLOBAL; i++)
+    if (name == keywords[i]) return Keyword(i);
+  return K_NONE;
+}
+
+enum TokKind { T_NAME, T_INT, T_PUNCT, T_WORD, T_END };
+
+struct Token {
+  TokKind kind;
+  Keyword kw;  // names only
+  std::string_view text;
+  int line;
+};
+
+bool is_name_start(unsigned char c) {
+  return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+bool is_name_char(unsigned char c) {
+  return is_name_start(c) || (c >= '0' && c <= '9');
+}
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Reads the IR in a single pass. Tokens are scanned from the buffer on
+// demand, with at most three tokens of lookahead, and every instruction
+// record is built as soon as its last token has been seen; no token list or
+// parse tree is materialised. Whitespace and C/C++ comments are skipped like
+// the %ignore directives of the Lark grammar in ir.py, and the accepted
+// instruction forms are exactly those of that grammar.
+class Reader {
+ public:
+  Reader(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+  std::vector<Inst> read() {
+    std::vector<Inst> insts;
+    insts.reserve((end_ - p_) / 12);
+    while (peek().kind != T_END) insts.push_back(instruction());
+    return insts;
+  }
+
+ private:
+  const char *p_, *end_;
+  int line_ = 1;
+  bool after_hash_ = false;  // `#` is followed by a SIGNED_INT
+  Token la_[4];              // lookahead
+  int nla_ = 0;
+
+  [[noreturn]] void fail_at(int line, const std::string &msg) {
+    fail("line " + std::to_string(line) + ": " + msg);
+  }
+
+  void skip_blanks() {
+    while (p_ < end_) {
+      char c = *p_;
+      if (c == '\n') {
+        line_++;
+        p_++;
+      } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f') {
+        p_++;
+      } else if (c == '/' && p_ + 1 < end_ && p_[1] == '/') {
+        while (p_ < end_ && *p_ != '\n') p_++;
+      } else if (c == '/' && p_ + 1 < end_ && p_[1] == '*') {
+        const char *q = p_ + 2;
+        while (q + 1 < end_ && !(q[0] == '*' && q[1] == '/')) line_ += *q++ == '\n';
+        if (q + 1 >= end_) fail_at(line_, "unterminated comment");
+        p_ = q + 2;
+      } else {
+        break;
+      }
+    }
+  }
+
+  Token scan() {
+    skip_blanks();
+    if (p_ >= end_) return Token{T_END, K_NONE, "", line_};
+    const char *start = p_;
+    char c = *p_;
+    TokKind kind = T_PUNCT;
+    if ((is_digit(c) || (after_hash_ && (c == '+' || c == '-') && p_ + 1 < end_ && is_digit(p_[1])))) {
+      p_++;
+      while (p_ < end_ && is_digit(*p_)) p_++;
+      kind = T_INT;
+    } else if (is_name_start(c)) {
+      while (p_ < end_ && is_name_char(*p_)) p_++;
+      kind = T_NAME;
+    } else if (c == '.' && end_ - p_ >= 5 && memcmp(p_, ".WORD", 5) == 0) {
+      p_ += 5;
+      kind = T_WORD;
+    } else if ((c == '<' || c == '>' || c == '=' || c == '!') && p_ + 1 < end_ && p_[1] == '=') {
+      p_ += 2;
+    } else if (strchr("<>=:*&#+-/%", c)) {
+      p_++;
+    } else {
+      fail_at(line_, std::string("unexpected character '") + c + "'");
+    }
+    after_hash_ = c == '#';
+    std::string_view text(start, p_ - start);
+    return Token{kind, kind == T_NAME ? keyword_of(text) : K_NONE, text, line_};
+  }
+
+  const Token &peek(int k = 0) {
+    while (nla_ <= k) la_[nla_++] = scan();
+    return la_[k];
+  }
+
+  Token take() {
+    Token t = peek();
+    for (int i = 1; i < nla_; i++) la_[i - 1] = la_[i];
+    nla_--;
+    return t;
+  }
+
+  bool is_punct(int k, const char *p) { return peek(k).kind == T_PUNCT && peek(k).text == p; }
+  bool is_kw(int k, Keyword kw) { return peek(k).kw == kw; }
+
+  [[noreturn]] void error() {
+    const Token &t = peek();
+    fail_at(t.line, "unexpected token '" + std::string(t.text) + "'");
+  }
+
+  void expect_punct(const char *p) {
+    if (!is_punct(0, p)) error();
+    take();
+  }
+
+  std::string_view name() {
+    if (peek().kind != T_NAME || peek().kw != K_NONE) error();
+    return take().text;
+  }
+
+  word imm() {
+    expect_punct("#");
+    if (peek().kind != T_INT) error();
+    std::string_view digits = take().text;
+    bool neg = digits[0] == '-';
+    if (digits[0] == '-' || digits[0] == '+') digits.remove_prefix(1);
+    unsigned long long v = 0;
+    for (char d : digits) v = v * 10 + (d - '0');
+    return (word)(neg ? 0 - v : v);
+  }
+
+  bool at_relop() {
+    const Token &t = peek();
+    return t.kind == T_PUNCT && (t.text[0] == '<' || t.text[0] == '>' || t.text == "==" || t.text == "!=");
+  }
+
+  bool at_binop() {
+    const Token &t = peek();
+    return t.kind == T_PUNCT && t.text.size() == 1 && strchr("+-*/%", t.text[0]);
+  }
+
+  Inst instruction() {
+    Inst in;
+    switch (peek().kw) {
+      case K_LABEL:
+      case K_FUNCTION:
+      case K_GLOBAL:
+        in.kind = is_kw(0, K_LABEL) ? I_LABEL : is_kw(0, K_FUNCTION) ? I_FUNCTION : I_GLOBAL;
+        take();
+        in.dst = name();
+        expect_punct(":");
+        break;
+      case K_GOTO:
+      case K_PARAM:
+      case K_ARG:
+      case K_CALL:
+        in.kind = is_kw(0, K_GOTO) ? I_GOTO : is_kw(0, K_PARAM) ? I_PARAM : is_kw(0, K_ARG) ? I_ARG : I_CALL;
+        take();
+        // CALL without destination keeps `dst` empty and names the callee in `a`
+        (in.kind == I_CALL ? in.a : in.dst) = name();
+        break;
+      case K_IF:
+        in.kind = I_IF;
+        take();
+        in.a = name();
+        if (!at_relop()) error();
+        in.op = take().text;
+        in.b = name();
+        if (!is_kw(0, K_GOTO)) error();
+        take();
+        in.dst = name();
+        break;
+      case K_RETURN:
+        in.kind = I_RETURN;
+        take();
+        // `RETURN x` unless the next name starts an assignment of its own
+        if (peek().kind == T_NAME && peek().kw == K_NONE && !is_punct(1, "="))
+          in.dst = name();
+        break;
+      case K_DEC:
+        in.kind = I_DEC;
+        take();
+        in.dst = name();
+        in.imm = imm();
+        break;
+      case K_NONE:
+        if (peek().kind == T_WORD) {
+          in.kind = I_WORD;
+          take();
+          in.imm = imm();
+        } else if (is_punct(0, "*")) {
+          in.kind = I_STORE;
+          take();
+          in.dst = name();
+          expect_punct("=");
+          in.a = name();
+        } else {
+          in.dst = name();
+          expect_punct("=");
+          rvalue(in);
+        }
+        break;
+    }
+    return in;
+  }
+
+  void rvalue(Inst &in) {
+    if (is_punct(0, "#")) {
+      in.kind = I_LI;
+      in.imm = imm();
+    } else if (is_punct(0, "*") || is_punct(0, "&")) {
+      in.kind = is_punct(0, "*") ? I_DEREF : I_LA;
+      take();
+      in.a = name();
+    } else if (is_kw(0, K_CALL)) {
+      in.kind = I_CALL;
+      take();
+      in.a = name();
+    } else if (is_punct(0, "-") || is_punct(0, "+")) {
+      in.kind = I_UNARY;
+      in.op = take().text;
+      in.a = name();
+    } else {
+      in.a = name();
+      // `x = y` followed by a store `*p = q` is not a multiplication
+      bool store_follows = is_punct(0, "*") && peek(1).kind == T_NAME && is_punct(2, "=");
+      if (!at_binop() || store_follows) {
+        in.kind = I_ASSIGN;
+        return;
+      }
+      in.op = take().text;
+      if (is_punct(0, "#")) {
+        in.kind = I_BINARYI;
+        in.imm = imm();
+      } else {
+        in.kind = I_BINARY;
+        in.b = name();
+      }
+    }
+  }
+};
+
+// ---------------------------------------------------------------- decode --
+
+// Instructions are decoded once at load time: every variable becomes a
+// dense slot index into the frame, every label an offset into the code,
+// every callee an index into the function table, and every operator its own
+// opcode. The dispatch loop below then only ever works on integers.
+enum Opcode : unsigned char {
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,       // r[dst] = r[a] op r[b]
+  OP_ADDI, OP_SUBI, OP_MULI, OP_DIVI, OP_MODI,  // r[dst] = r[a] op imm
+  OP_NEG, OP_MOV, OP_LI,
+  OP_JMP, OP_JLT, OP_JGT, OP_JLE, OP_JGE, OP_JEQ, OP_JNE,  // goto imm
+  OP_ARG, OP_PARAM, OP_CALL, OP_READ, OP_WRITE, OP_RET, OP_RETV,
+  OP_DEC, OP_STORE, OP_LOAD,
+  OP_TRAP,  // raise messages[imm]
+};
+
+struct Code {
+  Opcode op;
+  int dst, a, b;  // slot indices, -1 when absent
+  word imm;       // immediate, jump target or callee index
+};
+
+struct Function {
+  std::string name;
+  std::vector<Code> code;
+  std::vector<std::string> slots;  // slot index -> variable name
+};
+
+const char *const binops = "+-*/%";
+const char *const relops[] = {"<", ">", "<=", ">=", "==", "!="};
+
+Opcode binop_code(std::string_view op, bool imm) {
+  Opcode base = imm ? OP_ADDI : OP_ADD;
+  return Opcode(base + (strchr(binops, op[0]) - binops));
+}
+
+Opcode relop_code(std::string_view op) {
+  for (int i = 0; i < 6; i++)
+    if (op == relops[i]) return Opcode(OP_JLT + i);
+  fail(std::string(op) + " in relop is not implemented.");
+}
+
+typedef unsigned long long uword;
+
+inline word do_div(word x, word y) {
+  if (y == 0) fail("division by zero");
+  if (y == -1) return (word)(0 - (uword)x);
+  return x / y;
+}
+
+inline word do_mod(word x, word y) {
+  if (y == 0) fail("integer modulo by zero");
+  if (y == -1) return 0;
+  word r = x % y;
+  if (r != 0 && ((r < 0) != (y < 0))) r += y;
+  return r;
+}
+
+// --------------------------------------------------------------- machine --
+
+const word heap_base = 0x1000;
+const size_t heap_limit = (size_t)1 << 27;  // words, i.e. 1 GiB of int64
+
+class Machine {
+ public:
+  void load(std::vector<Inst> insts);
+  // Run main; returns false when it returned without a value.
+  bool run(word &result);
+
+ private:
+  std::vector<Function> funcs_;
+  std::unordered_map<std::string_view, int> func_index_;
+  std::unordered_map<std::string_view, word> labels_;  // addresses of globals
+  std::vector<std::string> messages_;              // OP_TRAP texts
+  // DEC and GLOBAL memory: one word-addressed heap starting at heap_base.
+  // A frame's DEC arrays are released when it returns, so recursion reuses
+  // the same words instead of growing the heap.
+  std::vector<word> heap_;
+  size_t top_ = 0;  // words in use
+  unsigned seed_ = 1;
+
+  word new_array(word size);
+  word &at(word address) {
+    uword offset = (uword)(address - heap_base);
+    if (offset >= (uword)top_ * 4) fail("address " + std::to_string(address) + " not found");
+    return heap_[offset / 4];
+  }
+  void decode(Function &f, const std::vector<const Inst *> &body);
+};
+
+word Machine::new_array(word size) {
+  if (size < 0) fail("negative array size " + std::to_string(size));
+  size_t words = (size + 3) / 4;
+  if (words > heap_limit - top_) fail("out of memory");
+  word start = heap_base + (word)top_ * 4;
+  top_ += words;
+  if (top_ > heap_.size()) {
+    // ir.py fills fresh arrays with random garbage; do the same, reproducibly.
+    // Reused words simply keep whatever the previous frame left there.
+    size_t old = heap_.size();
+    heap_.resize(std::max(top_, old * 2));
+    for (size_t i = old; i < heap_.size(); i++) {
+      seed_ = seed_ * 1103515245u + 12345u;
+      heap_[i] = 1 + (seed_ >> 16) % 0xffff;
+    }
+  }
+  return start;
+}
+
+void Machine::decode(Function &f, const std::vector<const Inst *> &body) {
+  std::unordered_map<std::string_view, int> slot_of;
+  auto slot = [&](std::string_view name) -> int {
+    if (name.empty()) return -1;
+    auto it = slot_of.find(name);
+    if (it != slot_of.end()) return it->second;
+    f.slots.emplace_back(name);
+    return slot_of[name] = (int)f.slots.size() - 1;
+  };
+  auto trap = [&](const std::string &msg) -> Code {
+    messages_.push_back(msg);
+    return Code{OP_TRAP, -1, -1, -1, (word)messages_.size() - 1};
+  };
+
+  // labels resolve to the offset of the next real instruction
+  std::unordered_map<std::string_view, word> target;
+  word n = 0;
+  for (const Inst *in : body) {
+    if (in->kind == I_LABEL)
+      target[in->dst] = n;
+    else
+      n++;
+  }
+  // jumps to unknown labels go to a trap appended after the body, so the
+  // error is only raised when the jump is actually taken, as in ir.py
+  std::vector<Code> traps;
+  auto jump = [&](std::string_view label) -> word {
+    auto it = target.find(label);
+    if (it != target.end()) return it->second;
+    traps.push_back(trap("Label " + std::string(label) + " in function " + f.name + " is not defined."));
+    return target[label] = n + (word)traps.size() - 1;
+  };
+
+  for (const Inst *in : body) {
+    Code c{OP_TRAP, -1, -1, -1, 0};
+    switch (in->kind) {
+      case I_LABEL:
+        continue;
+      case I_BINARY:
+        c = Code{binop_code(in->op, false), slot(in->dst), slot(in->a), slot(in->b), 0};
+        break;
+      case I_BINARYI:
+        c = Code{binop_code(in->op, true), slot(in->dst), slot(in->a), -1, in->imm};
+        break;
+      case I_UNARY:
+        c = Code{in->op == "-" ? OP_NEG : OP_MOV, slot(in->dst), slot(in->a), -1, 0};
+        break;
+      case I_ASSIGN:
+        c = Code{OP_MOV, slot(in->dst), slot(in->a), -1, 0};
+        break;
+      case I_LI:
+        c = Code{OP_LI, slot(in->dst), -1, -1, in->imm};
+        break;
+      case I_LA: {
+        auto it = labels_.find(in->a);
+        if (it == labels_.end())
+          c = trap("Label " + std::string(in->a) + " in function " + f.name + " is not defined.");
+        else
+          c = Code{OP_LI, slot(in->dst), -1, -1, it->second};
+        break;
+      }
+      case I_GOTO:
+        c = Code{OP_JMP, -1, -1, -1, jump(in->dst)};
+        break;
+      case I_IF:
+        c = Code{relop_code(in->op), -1, slot(in->a), slot(in->b), jump(in->dst)};
+        break;
+      case I_RETURN:
+        c = in->dst.empty() ? Code{OP_RET, -1, -1, -1, 0} : Code{OP_RETV, -1, slot(in->dst), -1, 0};
+        break;
+      case I_ARG:
+        c = Code{OP_ARG, -1, slot(in->dst), -1, 0};
+        break;
+      case I_PARAM:
+        c = Code{OP_PARAM, slot(in->dst), -1, -1, 0};
+        break;
+      case I_CALL:
+        if (in->a == "read") {
+          c = Code{OP_READ, slot(in->dst), -1, -1, 0};
+        } else if (in->a == "write") {
+          c = Code{OP_WRITE, -1, -1, -1, 0};
+        } else {
+          auto it = func_index_.find(in->a);
+          if (it == func_index_.end())
+            c = trap("Variable " + std::string(in->a) + " is not defined.");
+          else
+            c = Code{OP_CALL, slot(in->dst), -1, -1, it->second};
+        }
+        break;
+      case I_DEC:
+        c = Code{OP_DEC, slot(in->dst), -1, -1, in->imm};
+        break;
+      case I_STORE:
+        c = Code{OP_STORE, -1, slot(in->dst), slot(in->a), 0};
+        break;
+      case I_DEREF:
+        c = Code{OP_LOAD, slot(in->dst), slot(in->a), -1, 0};
+        break;
+      default:
+        c = trap("instruction is not implemented.");
+        break;
+    }
+    f.code.push_back(c);
+  }
+  // falling off the end of the body
+  f.code.push_back(trap("No return statement in function " + f.name + "."));
+  f.code.insert(f.code.end() - 1, traps.begin(), traps.end());
+}
+
+void Machine::load(std::vector<Inst> insts) {
+  if (insts.empty() || (insts[0].kind != I_FUNCTION && insts[0].kind != I_GLOBAL))
+    fail("IR should start with a FUNCTION or GLOBAL.");
+  std::vector<std::string_view> global_order;
+  std::unordered_map<std::string_view, std::vector<word>> global_words;
+  std::vector<word> *current_var = nullptr;
+  std::vector<std::vector<const Inst *>> bodies;
+  for (const Inst &in : insts) {
+    switch (in.kind) {
+      case I_FUNCTION:
+        // a later definition of the same name replaces the earlier one
+        func_index_[in.dst] = (int)funcs_.size();
+        funcs_.push_back(Function{std::string(in.dst), {}, {}});
+        bodies.emplace_back();
+        current_var = nullptr;
+        break;
+      case I_GLOBAL:
+        if (!funcs_.empty()) fail("Global variable should be defined before function.");
+        if (!global_words.count(in.dst)) global_order.push_back(in.dst);
+        current_var = &global_words[in.dst];
+        current_var->clear();
+        break;
+      case I_WORD:
+        if (!current_var) fail("No global variable to fill");
+        current_var->push_back(in.imm);
+        break;
+      default:
+        if (bodies.empty()) fail("instruction outside of a function");
+        bodies.back().push_back(&in);
+        break;
+    }
+  }
+  for (std::string_view name : global_order) {
+    const std::vector<word> &values = global_words[name];
+    word address = new_array(values.size() * 4);
+    for (size_t i = 0; i < values.size(); i++) at(address + i * 4) = values[i];
+    labels_[name] = address;
+  }
+  if (!func_index_.count("main")) fail("No main function.");
+  for (size_t i = 0; i < funcs_.size(); i++) decode(funcs_[i], bodies[i]);
+}
+
+struct Frame {
+  const Function *func;
+  const Code *pc;
+  size_t base;         // first slot of this frame in `regs`
+  size_t arg_base;     // arguments pushed by this frame start here
+  size_t param_next;   // next argument of the caller to hand to PARAM
+  size_t param_end;
+  size_t heap_top;     // heap words in use when the frame was entered
+  int ret_dst;         // caller slot receiving the return value, or -1
+};
+
+bool Machine::run(word &result) {
+  std::vector<word> regs;
+  std::vector<unsigned char> defined;  // reading an unset variable is an error
+  std::vector<word> args;
+  std::vector<Frame> frames;
+
+  auto enter = [&](const Function &f, size_t param_begin, int ret_dst) {
+    Frame fr{&f, f.code.data(), regs.size(), args.size(), param_begin, args.size(), top_, ret_dst};
+    regs.resize(regs.size() + f.slots.size());
+    defined.resize(regs.size(), 0);
+    frames.push_back(fr);
+  };
+  enter(funcs_[func_index_["main"]], 0, -1);
+
+  Frame *fr = &frames.back();
+  word *r = regs.data() + fr->base;
+  unsigned char *def = defined.data() + fr->base;
+
+  auto get = [&](int s) -> word {
+    if (!def[s]) fail("Variable " + fr->func->slots[s] + " is not defined.");
+    return r[s];
+  };
+  auto set = [&](int s, word v) {
+    r[s] = v;
+    def[s] = 1;
+  };
+  // return from the current frame; false once main has returned
+  auto leave = [&](bool has_value, word value) -> bool {
+    int dst = fr->ret_dst;
+    size_t base = fr->base;
+    top_ = fr->heap_top;  // release the frame's DEC arrays
+    frames.pop_back();
+    if (frames.empty()) {
+      result = value;
+      return false;
+    }
+    regs.resize(base);
+    defined.resize(base);
+    fr = &frames.back();
+    args.resize(fr->arg_base);  // reset args
+    r = regs.data() + fr->base;
+    def = defined.data() + fr->base;
+    if (dst >= 0) {
+      if (has_value)
+        set(dst, value);
+      else
+        def[dst] = 0;
+    }
+    return true;
+  };
+
+  for (;;) {
+    const Code &c = *fr->pc++;
+    switch (c.op) {
+      case OP_ADD: set(c.dst, (word)((uword)get(c.a) + (uword)get(c.b))); break;
+      case OP_SUB: set(c.dst, (word)((uword)get(c.a) - (uword)get(c.b))); break;
+      case OP_MUL: set(c.dst, (word)((uword)get(c.a) * (uword)get(c.b))); break;
+      case OP_DIV: set(c.dst, do_div(get(c.a), get(c.b))); break;
+      case OP_MOD: set(c.dst, do_mod(get(c.a), get(c.b))); break;
+      case OP_ADDI: set(c.dst, (word)((uword)get(c.a) + (uword)c.imm)); break;
+      case OP_SUBI: set(c.dst, (word)((uword)get(c.a) - (uword)c.imm)); break;
+      case OP_MULI: set(c.dst, (word)((uword)get(c.a) * (uword)c.imm)); break;
+      case OP_DIVI: set(c.dst, do_div(get(c.a), c.imm)); break;
+      case OP_MODI: set(c.dst, do_mod(get(c.a), c.imm)); break;
+      case OP_NEG: set(c.dst, (word)(0 - (uword)get(c.a))); break;
+      case OP_MOV: set(c.dst, get(c.a)); break;
+      case OP_LI: set(c.dst, c.imm); break;
+      case OP_JMP: fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_JLT: if (get(c.a) < get(c.b)) fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_JGT: if (get(c.a) > get(c.b)) fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_JLE: if (get(c.a) <= get(c.b)) fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_JGE: if (get(c.a) >= get(c.b)) fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_JEQ: if (get(c.a) == get(c.b)) fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_JNE: if (get(c.a) != get(c.b)) fr->pc = fr->func->code.data() + c.imm; break;
+      case OP_ARG: args.push_back(get(c.a)); break;
+      case OP_PARAM:
+        if (fr->param_next >= fr->param_end) fail("Function " + fr->func->name + " needs more parameters.");
+        set(c.dst, args[fr->param_next++]);
+        break;
+      case OP_CALL: {
+        // the callee takes the arguments pushed since the last call
+        enter(funcs_[c.imm], fr->arg_base, c.dst);
+        fr = &frames.back();
+        r = regs.data() + fr->base;
+        def = defined.data() + fr->base;
+        break;
+      }
+      case OP_READ: {
+        char buf[128];
+        if (!fgets(buf, sizeof buf, stdin)) fail("EOF when reading a line");
+        char *end;
+        word v = strtoll(buf, &end, 10);
+        while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') end++;
+        if (end == buf || *end) fail("invalid literal for int(): " + std::string(buf));
+        if (c.dst >= 0) set(c.dst, v);
+        break;
+      }
+      case OP_WRITE:
+        if (args.size() <= fr->arg_base) fail("write needs an argument");
+        printf("%lld\n", args[fr->arg_base]);
+        args.resize(fr->arg_base);
+        break;
+      case OP_RET:
+        if (!leave(false, 0)) return false;
+        break;
+      case OP_RETV:
+        if (!leave(true, get(c.a))) return true;
+        break;
+      case OP_DEC: set(c.dst, new_array(c.imm)); break;
+      case OP_STORE: at(get(c.a)) = get(c.b); break;
+      case OP_LOAD: set(c.dst, at(get(c.a))); break;
+      case OP_TRAP: fail(messages_[c.imm]);
+    }
+  }
+}
+
+// Read the whole file with a single fread when its size is known.
+std::string read_file(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) fail(std::string("unable to open ") + path);
+  std::string text;
+  if (fseek(fp, 0, SEEK_END) == 0) {
+    long size = ftell(fp);
+    rewind(fp);
+    if (size > 0) {
+      text.resize(size);
+      text.resize(fread(&text[0], 1, size, fp));
+    }
+  }
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, fp)) > 0) text.append(buf, n);
+  fclose(fp);
+  return text;
+}
+
+}  // namespace
+
+int irvm_run(const char *path, bool test_mode) {
+  try {
+    std::string text = read_file(path);
+    Machine vm;
+    vm.load(Reader(text.data(), text.data() + text.size()).read());
+    word ret = 0;
+    bool has_value = vm.run(ret);
+    if (!test_mode) {
+      // 0 green, else red
+      if (has_value && ret == 0)
+        printf("exit with code \033[1;32m%lld\033[0m\n", ret);
+      else if (has_value)
+        printf("exit with code \033[1;31m%lld\033[0m\n", ret);
+      else
+        printf("exit with code \033[1;31mNone\033[0m\n");
+    }
+  } catch (const VmError &e) {
+    fflush(stdout);
+    fprintf(stderr, "Error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
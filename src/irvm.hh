@@ -0,0 +1,13 @@
+#pragma once
+
+// Native interpreter for the textual IR that ir.py accepts.
+//
+// It reads the same instruction forms (FUNCTION/LABEL/GOTO/IF/DEC/GLOBAL/
+// .WORD/ARG/PARAM/CALL/...), prints the same output and exits with the same
+// status as `python ir.py`, so test.py can run lab3 programs without
+// starting a Python interpreter.
+
+// Interpret the IR file at `path`. Unless `test_mode` is set, the value
+// returned by main is reported the way ir.py does. Returns the process
+// exit code: 0 on success, 1 on any parse or runtime error.
+int irvm_run(const char *path, bool test_mode);
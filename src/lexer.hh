@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+#include "ast.hh"
+#include "token_dump.hh"
+
+// Interface to the reentrant flex scanner in sysy.l. Every translation unit
+// gets its own scanner, so units can be lexed and parsed on different
+// threads at the same time.
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+// Per-unit state the scanner rules reach through yyextra.
+struct LexExtra {
+  Ast *ast;            // identifiers are interned into ast->names
+  TokenDump *tokens;   // token trace, null when off
+};
+
+// Start scanning `len` bytes at `buf` in place; buf[len] and buf[len + 1]
+// must be NUL. The buffer and `extra` must outlive the scanner.
+yyscan_t lex_begin(char *buf, size_t len, LexExtra *extra);
+void lex_end(yyscan_t scanner);
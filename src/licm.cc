@@ -0,0 +1,142 @@
+#include <algorithm>
+#include "ast.hh"
+#include "cfg.hh"
+#include "dominance.hh"
+#include "opt.hh"
+
+namespace {
+
+struct Loop {
+  uint32_t header, preheader;
+  std::vector<uint32_t> blocks;  // header included, in reverse postorder
+};
+
+size_t index_of(const std::vector<uint32_t> &list, uint32_t x) {
+  return std::find(list.begin(), list.end(), x) - list.begin();
+}
+
+// The one predecessor of `header` from outside its loop, or UINT32_MAX if
+// there are several.
+uint32_t entry_of(const Cfg &cfg, const DomTree &dom, uint32_t header) {
+  uint32_t entry = UINT32_MAX;
+  for (uint32_t p : cfg.blocks[header].preds) {
+    if (dom.dominates(header, p)) continue;
+    if (entry != UINT32_MAX) return UINT32_MAX;
+    entry = p;
+  }
+  return entry;
+}
+
+// Give every loop a preheader: a block whose only successor is the header
+// and that is the header's only predecessor from outside the loop. A loop
+// lowered from `while` enters through a GOTO, so its entry block already is
+// one; otherwise the entry edge is split. Loops entered from several
+// blocks are never lowered from SysY and get none.
+void add_preheaders(Cfg &cfg, const DomTree &dom) {
+  uint32_t n = cfg.blocks.size();
+  for (uint32_t h = 0; h < n; h++) {
+    const std::vector<uint32_t> &preds = cfg.blocks[h].preds;
+    bool header = std::any_of(preds.begin(), preds.end(), [&](uint32_t p) { return dom.dominates(h, p); });
+    if (!header) continue;
+    uint32_t entry = entry_of(cfg, dom, h);
+    if (entry == UINT32_MAX || cfg.blocks[entry].succs.size() == 1) continue;
+    cfg.split_edge(entry, index_of(cfg.blocks[entry].succs, h));
+  }
+}
+
+// Natural loops, one per header however many back edges it has, with
+// inner loops before the loops containing them.
+std::vector<Loop> find_loops(const Cfg &cfg, const DomTree &dom) {
+  uint32_t n = cfg.blocks.size();
+  std::vector<uint32_t> order(n), seen(n, UINT32_MAX), work;
+  for (uint32_t k = 0; k < n; k++) order[dom.rpo()[k]] = k;
+  std::vector<Loop> loops;
+  for (uint32_t h = 0; h < n; h++) {
+    Loop loop{h, entry_of(cfg, dom, h), {h}};
+    seen[h] = h;
+    for (uint32_t p : cfg.blocks[h].preds) {
+      if (dom.dominates(h, p)) work.push_back(p);
+    }
+    if (work.empty() || loop.preheader == UINT32_MAX) {
+      work.clear();
+      continue;
+    }
+    while (!work.empty()) {
+      uint32_t b = work.back();
+      work.pop_back();
+      if (seen[b] == h) continue;
+      seen[b] = h;
+      loop.blocks.push_back(b);
+      for (uint32_t p : cfg.blocks[b].preds) work.push_back(p);
+    }
+    std::sort(loop.blocks.begin(), loop.blocks.end(), [&](uint32_t a, uint32_t b) { return order[a] < order[b]; });
+    loops.push_back(std::move(loop));
+  }
+  std::stable_sort(loops.begin(), loops.end(),
+                   [](const Loop &a, const Loop &b) { return a.blocks.size() < b.blocks.size(); });
+  return loops;
+}
+
+// Whether `i` can run where it did not before: it has no effect but its
+// value and cannot fail.
+bool speculable(const IrInst &i) {
+  switch (i.op) {
+    case IR_LI: case IR_LA: case IR_NEG:
+      return true;
+    case IR_BIN:
+      return i.sub != OP_DIV && i.sub != OP_MOD;
+    case IR_BINI:
+      return (i.sub != OP_DIV && i.sub != OP_MOD) || i.imm != 0;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+void hoist_invariants(Cfg &cfg) {
+  add_preheaders(cfg, DomTree(cfg));
+  DomTree dom(cfg);
+  std::vector<Loop> loops = find_loops(cfg, dom);
+  if (loops.empty()) return;
+
+  // A variable assigned more than once keeps its name only while its
+  // versions do not overlap (ssa.hh); moving one of them to a preheader
+  // would make it overlap the others.
+  std::vector<char> versioned(cfg.f.values.size());
+  for (uint32_t v = 1; v < versioned.size(); v++) {
+    if (cfg.origin_of(v) != v) versioned[v] = versioned[cfg.origin_of(v)] = 1;
+  }
+  std::vector<uint32_t> def_block(cfg.f.values.size());
+  for (uint32_t b = 0; b < cfg.blocks.size(); b++) {
+    for (const IrInst &i : cfg.blocks[b].code) {
+      if (ir_defines(i)) def_block[i.dst] = b;
+    }
+  }
+  std::vector<uint32_t> in_loop(cfg.blocks.size(), UINT32_MAX);
+  std::vector<IrInst> hoisted;
+  for (uint32_t l = 0; l < loops.size(); l++) {
+    const Loop &loop = loops[l];
+    for (uint32_t b : loop.blocks) in_loop[b] = l;
+    hoisted.clear();
+    for (uint32_t b : loop.blocks) {
+      std::vector<IrInst> &code = cfg.blocks[b].code;
+      size_t out = 0;
+      for (IrInst &i : code) {
+        uint32_t *ops[2];
+        int count = ir_uses(i, ops);
+        bool invariant = speculable(i) && !versioned[i.dst];
+        for (int k = 0; k < count && invariant; k++) invariant = in_loop[def_block[*ops[k]]] != l;
+        if (invariant) {
+          def_block[i.dst] = loop.preheader;
+          hoisted.push_back(i);
+        } else {
+          code[out++] = i;
+        }
+      }
+      code.resize(out);
+    }
+    std::vector<IrInst> &pre = cfg.blocks[loop.preheader].code;
+    pre.insert(pre.end() - 1, hoisted.begin(), hoisted.end());
+  }
+}
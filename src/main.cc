@@ -1,7 +1,9 @@
 #include <stdio.h>
-#define INPUTFILE "tests/lab1/1.sy"
-extern int yyparse();
-extern FILE *yyin;
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "driver.hh"
+#include "irvm.hh"
 
 
 // int main() {
@@ -10,14 +12,59 @@ extern FILE *yyin;
 // }
 //
 
-int main(){
-  yyin = fopen(INPUTFILE,"r");
-  if(yyin==NULL){
-    printf("unable to open input\n");
+static const char usage[] =
+    "usage: compiler [options] input.sy [output.ir]\n"
+    "       compiler [options] -j N input.sy...\n"
+    "       compiler [options] --batch list.txt\n"
+    "       compiler --run [-t] input.ir\n"
+    "options:\n"
+    "  --check         only parse and check, write no output\n"
+    "  --syntax-only   only parse, ignore semantic errors\n"
+    "  --dump-tokens   print the token stream\n"
+    "  --dump-ast      print the syntax tree\n"
+    "  --time          report time per phase, throughput and peak memory\n"
+    "  -j N            compile on N threads; every file is an input and\n"
+    "                  a.sy is written to a.ir\n";
+
+int main(int argc, char **argv){
+  // compiler --run [-t] file.ir : 直接解释执行 IR，代替 python ir.py
+  if(argc >= 3 && strcmp(argv[1], "--run") == 0){
+    bool test_mode = argc >= 4 && strcmp(argv[2], "-t") == 0;
+    return irvm_run(argv[argc - 1], test_mode);
+  }
+  Options opt;
+  const char *batch = nullptr;
+  bool parallel = false;
+  std::vector<const char *> files;
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "--dump-ast") == 0) opt.dump_ast = true;
+    else if(strcmp(argv[i], "--dump-tokens") == 0) opt.dump_tokens = true;
+    else if(strcmp(argv[i], "--time") == 0) opt.time = true;
+    else if(strcmp(argv[i], "--check") == 0) opt.check = true;
+    else if(strcmp(argv[i], "--syntax-only") == 0) opt.syntax_only = true;
+    else if(strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch = argv[++i];
+    else if(strncmp(argv[i], "-j", 2) == 0 && (argv[i][2] || i + 1 < argc)){
+      const char *n = argv[i][2] ? argv[i] + 2 : argv[++i];
+      opt.jobs = atoi(n) > 0 ? atoi(n) : 1;
+      parallel = true;
+    }
+    else if(argv[i][0] == '-' && argv[i][1] != '\0'){
+      fprintf(stderr, "unknown option %s\n%s", argv[i], usage);
+      return 1;
+    }
+    else files.push_back(argv[i]);
+  }
+  // 一次编译列表中的所有文件，省去每个文件启动一个进程
+  if(batch && files.empty()) return compile_batch(batch, opt);
+  if(batch || files.empty() || (!parallel && files.size() > 2)){
+    fprintf(stderr, "%s", usage);
     return 1;
   }
-  yyparse();
-  // int yylex();  // 调用词法分析器，每次返回一个TOKEN
-  fclose(yyin);
-  return 0;
-}
\ No newline at end of file
+  // -j：每个参数都是输入文件，在线程池上并行编译
+  if(parallel){
+    std::vector<Job> jobs;
+    for(const char *f : files) jobs.push_back(Job{f, default_output(f)});
+    return compile_files(jobs, opt);
+  }
+  return compile_file(files[0], files.size() > 1 ? files[1] : nullptr, opt);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+class Cfg;
+class DomTree;
+
+// Optimizations on a Cfg in SSA form (ssa.hh). Each keeps the code in SSA
+// form; one that changes edges says so, and the DomTree of the Cfg has to
+// be built again after it.
+
+// Sparse conditional constant propagation (Wegman and Zadeck): finds the
+// values that are constant on every path the code can take, assuming
+// branches only go where a constant condition lets them. Those values are
+// assigned with an LI, an operand known to be constant becomes an
+// immediate where an instruction has one, an IF that always goes one way
+// becomes a GOTO, and the blocks no longer reached are removed. Changes
+// edges.
+void propagate_constants(Cfg &cfg);
+
+// Global value numbering over the dominator tree: an instruction that
+// computes what one in a dominating block (or earlier in its own) already
+// did is removed and its value replaced by that one. Copies and
+// operations with an identity immediate go the same way, as do phis that
+// choose between one value and themselves. A LOAD is only matched with
+// one reading the same address with no STORE or CALL in between, or with
+// the value a STORE just put there.
+void number_values(Cfg &cfg, const DomTree &dom);
+
+// Loop-invariant code motion. Natural loops are found from the back edges
+// of the dominator tree, each gets a preheader, and instructions whose
+// operands are all assigned outside a loop move to its preheader, inner
+// loops first so that what leaves an inner loop can leave the outer one
+// too. Only instructions that cannot fail move, since the preheader also
+// runs when the loop body does not: no LOAD and no division by a value.
+// Changes edges.
+void hoist_invariants(Cfg &cfg);
+
+// Dead code elimination. An assignment survives only if an instruction
+// with an effect (a store, call, argument, parameter, branch or return)
+// needs its value, directly or through other assignments; a call keeps
+// its effect but drops an unused result. Before that, a STORE goes if a
+// later one in its block writes the same address with no LOAD or CALL in
+// between, or if it writes an array from DEC that is never read.
+void remove_dead_code(Cfg &cfg);
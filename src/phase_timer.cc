@@ -0,0 +1,32 @@
+#include "phase_timer.hh"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+// Peak resident set in KiB. ru_maxrss survives exec, so a compiler started
+// by a big parent process would report the parent's peak; VmHWM in /proc
+// belongs to this process image alone.
+static long peak_rss_kib() {
+  long kib = -1;
+  if (FILE *fp = fopen("/proc/self/status", "r")) {
+    char line[256];
+    while (fgets(line, sizeof line, fp))
+      if (strncmp(line, "VmHWM:", 6) == 0) kib = atol(line + 6);
+    fclose(fp);
+  }
+  if (kib < 0) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);  // KiB on Linux
+    kib = ru.ru_maxrss;
+  }
+  return kib;
+}
+
+void PhaseTimer::report(FILE *out, const char *input, size_t lines, size_t bytes) const {
+  double total = 0;
+  for (const Phase &p : phases_) total += p.seconds;
+  fprintf(out, "%s: %zu lines, %.1f KiB\n", input, lines, bytes / 1024.0);
+  for (const Phase &p : phases_) fprintf(out, "  %-8s %10.3f ms\n", p.name, p.seconds * 1e3);
+  fprintf(out, "  %-8s %10.3f ms  %.0f lines/s\n", "total", total * 1e3, total > 0 ? lines / total : 0.0);
+  fprintf(out, "  %-8s %10.1f MiB\n", "peak rss", peak_rss_kib() / 1024.0);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+// Wall-clock time of the compiler's phases for one translation unit,
+// collected when --time is given. Usage:
+//
+//   PhaseTimer timer;
+//   ...read...   timer.lap("read");
+//   ...parse...  timer.lap("parse");
+//   timer.report(stderr, path, lines, bytes);
+class PhaseTimer {
+ public:
+  PhaseTimer() : last_(clock::now()) {}
+
+  // Charge the time since the previous lap to `phase`, less `overlap`
+  // seconds of work it repeated from a phase timed on its own. Returns
+  // the seconds charged.
+  double lap(const char *phase, double overlap = 0) {
+    clock::time_point now = clock::now();
+    double seconds = std::chrono::duration<double>(now - last_).count() - overlap;
+    if (seconds < 0) seconds = 0;  // timing noise on tiny inputs
+    last_ = now;
+    add(phase, seconds);
+    return seconds;
+  }
+
+  void add(const char *phase, double seconds) { phases_.push_back(Phase{phase, seconds}); }
+
+  // Print one line per phase, the total with throughput in source lines
+  // per second, and the peak RSS of the process so far.
+  void report(FILE *out, const char *input, size_t lines, size_t bytes) const;
+
+ private:
+  typedef std::chrono::steady_clock clock;
+  struct Phase {
+    const char *name;
+    double seconds;
+  };
+
+  clock::time_point last_;
+  std::vector<Phase> phases_;
+};
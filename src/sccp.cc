@@ -0,0 +1,233 @@
+#include <algorithm>
+#include "ast.hh"
+#include "cfg.hh"
+#include "opt.hh"
+
+namespace {
+
+enum Lattice : uint8_t {
+  L_UNKNOWN,   // no assignment seen to run yet
+  L_CONST,     // always the same value
+  L_VARYING,
+};
+
+size_t index_of(const std::vector<uint32_t> &list, uint32_t x) {
+  return std::find(list.begin(), list.end(), x) - list.begin();
+}
+
+class Propagation {
+ public:
+  explicit Propagation(Cfg &cfg);
+
+  void run();
+  void rewrite();
+
+ private:
+  typedef std::pair<uint32_t, uint32_t> Site;  // block, index
+
+  void reach(uint32_t from, uint32_t to);
+  void visit(uint32_t block, uint32_t index);
+  void set(uint32_t v, Lattice state, int32_t value = 0);
+  bool edge(uint32_t block, size_t pred) const { return executable_[edge_start_[block] + pred]; }
+
+  Cfg &cfg_;
+  std::vector<Lattice> state_;
+  std::vector<int32_t> value_;
+  std::vector<char> reached_, executable_;
+  std::vector<uint32_t> edge_start_;  // of each block's preds in executable_
+  std::vector<uint32_t> use_start_;
+  std::vector<Site> uses_;
+  std::vector<Site> edges_;  // from, to
+  std::vector<uint32_t> values_;
+};
+
+Propagation::Propagation(Cfg &cfg)
+    : cfg_(cfg),
+      state_(cfg.f.values.size()),
+      value_(cfg.f.values.size()),
+      reached_(cfg.blocks.size()),
+      edge_start_(cfg.blocks.size() + 1),
+      use_start_(cfg.f.values.size() + 1) {
+  uint32_t values = cfg.f.values.size();
+  for (uint32_t b = 0; b < cfg.blocks.size(); b++) {
+    edge_start_[b + 1] = edge_start_[b] + cfg.blocks[b].preds.size();
+  }
+  executable_.resize(edge_start_.back());
+  // counting pass, then filling pass
+  for (int fill = 0; fill < 2; fill++) {
+    for (uint32_t b = 0; b < cfg.blocks.size(); b++) {
+      Block &block = cfg.blocks[b];
+      for (uint32_t n = 0; n < block.code.size(); n++) {
+        IrInst &i = block.code[n];
+        auto use = [&](uint32_t v) {
+          if (fill) uses_[use_start_[v]++] = {b, n};
+          else use_start_[v + 1]++;
+        };
+        uint32_t *ops[2];
+        for (int k = ir_uses(i, ops); k-- > 0;) use(*ops[k]);
+        if (i.op != IR_PHI) continue;
+        const uint32_t *args = cfg.phi_args(i);
+        for (size_t k = 0; k < block.preds.size(); k++) use(args[k]);
+      }
+    }
+    if (fill) break;
+    for (uint32_t v = 0; v < values; v++) use_start_[v + 1] += use_start_[v];
+    uses_.resize(use_start_[values]);
+  }
+  for (uint32_t v = values; v > 0; v--) use_start_[v] = use_start_[v - 1];
+  use_start_[0] = 0;
+}
+
+void Propagation::set(uint32_t v, Lattice state, int32_t value) {
+  if (state_[v] == L_VARYING || (state_[v] == state && value_[v] == value)) return;
+  if (state_[v] == L_CONST && state == L_CONST) state = L_VARYING;
+  state_[v] = state;
+  value_[v] = value;
+  values_.push_back(v);
+}
+
+void Propagation::reach(uint32_t from, uint32_t to) {
+  edges_.push_back({from, to});
+}
+
+// Evaluate one instruction of a reached block with what is known so far.
+void Propagation::visit(uint32_t b, uint32_t n) {
+  Block &block = cfg_.blocks[b];
+  IrInst &i = block.code[n];
+  auto known = [&](uint32_t v) { return state_[v] == L_CONST; };
+  switch (i.op) {
+    case IR_GOTO:
+      reach(b, block.succs[0]);
+      return;
+    case IR_IF: {
+      if (state_[i.a] == L_UNKNOWN || state_[i.b] == L_UNKNOWN) return;
+      int32_t taken;
+      if (known(i.a) && known(i.b) && fold_op(i.sub, value_[i.a], value_[i.b], taken)) {
+        reach(b, block.succs[taken ? 0 : 1]);
+      } else {
+        reach(b, block.succs[0]);
+        reach(b, block.succs[1]);
+      }
+      return;
+    }
+    case IR_PHI: {
+      const uint32_t *args = cfg_.phi_args(i);
+      for (size_t k = 0; k < block.preds.size(); k++) {
+        if (edge(b, k) && state_[args[k]] != L_UNKNOWN) set(i.dst, state_[args[k]], value_[args[k]]);
+      }
+      return;
+    }
+    case IR_LI:
+      set(i.dst, L_CONST, i.imm);
+      return;
+    case IR_MOV:
+      if (state_[i.a] != L_UNKNOWN) set(i.dst, state_[i.a], value_[i.a]);
+      return;
+    case IR_BIN:
+    case IR_BINI:
+    case IR_NEG: {
+      uint32_t rhs = i.op == IR_BIN ? i.b : i.a;
+      if (state_[i.a] == L_UNKNOWN || state_[rhs] == L_UNKNOWN) return;
+      int32_t r;
+      int32_t y = i.op == IR_BINI ? i.imm : value_[rhs];
+      int op = i.op == IR_NEG ? int(OP_NEG) : i.sub;
+      if (known(i.a) && known(rhs) && fold_op(op, value_[i.a], y, r)) set(i.dst, L_CONST, r);
+      else set(i.dst, L_VARYING);
+      return;
+    }
+    default:
+      if (ir_defines(i)) set(i.dst, L_VARYING);
+      return;
+  }
+}
+
+void Propagation::run() {
+  reached_[0] = 1;
+  for (uint32_t n = 0; n < cfg_.blocks[0].code.size(); n++) visit(0, n);
+  while (!edges_.empty() || !values_.empty()) {
+    while (!edges_.empty()) {
+      auto [from, to] = edges_.back();
+      edges_.pop_back();
+      char &e = executable_[edge_start_[to] + index_of(cfg_.blocks[to].preds, from)];
+      if (e) continue;
+      e = 1;
+      std::vector<IrInst> &code = cfg_.blocks[to].code;
+      // A block is evaluated whole when first reached; after that, a new
+      // edge into it only brings new phi operands.
+      bool first = !reached_[to];
+      reached_[to] = 1;
+      for (uint32_t n = 0; n < code.size() && (first || code[n].op == IR_PHI); n++) visit(to, n);
+    }
+    while (!values_.empty()) {
+      uint32_t v = values_.back();
+      values_.pop_back();
+      for (uint32_t u = use_start_[v]; u < use_start_[v + 1]; u++) {
+        if (reached_[uses_[u].first]) visit(uses_[u].first, uses_[u].second);
+      }
+    }
+  }
+}
+
+void Propagation::rewrite() {
+  std::vector<IrInst> lis;
+  for (uint32_t b = 0; b < cfg_.blocks.size(); b++) {
+    if (!reached_[b]) continue;
+    Block &block = cfg_.blocks[b];
+    // Branches that never go one way lose that edge.
+    IrInst &t = block.code.back();
+    int32_t taken;
+    if (t.op == IR_IF && state_[t.a] == L_CONST && state_[t.b] == L_CONST &&
+        fold_op(t.sub, value_[t.a], value_[t.b], taken)) {
+      uint32_t to = block.succs[taken ? 0 : 1], dead = block.succs[taken ? 1 : 0];
+      t = IrInst{IR_GOTO, 0, 0, 0, 0, 0};
+      block.succs.assign(1, to);
+      cfg_.remove_pred(dead, b);
+    }
+    lis.clear();
+    size_t out = 0;
+    for (IrInst &i : block.code) {
+      if (ir_defines(i) && state_[i.dst] == L_CONST) {
+        IrInst li{IR_LI, 0, i.dst, 0, 0, value_[i.dst]};
+        if (i.op == IR_PHI) {
+          lis.push_back(li);
+          continue;
+        }
+        i = li;
+      } else if (i.op == IR_BIN && state_[i.b] == L_CONST) {
+        i = IrInst{IR_BINI, i.sub, i.dst, i.a, 0, value_[i.b]};
+      } else if (i.op == IR_BIN && state_[i.a] == L_CONST && (i.sub == OP_ADD || i.sub == OP_MUL)) {
+        i = IrInst{IR_BINI, i.sub, i.dst, i.b, 0, value_[i.a]};
+      }
+      block.code[out++] = i;
+    }
+    block.code.resize(out);
+    auto at = std::find_if(block.code.begin(), block.code.end(), [](const IrInst &i) { return i.op != IR_PHI; });
+    block.code.insert(at, lis.begin(), lis.end());
+  }
+  cfg_.remove_unreachable();
+
+  // Constants that were only read as immediates are no longer needed.
+  std::vector<char> read(cfg_.f.values.size());
+  for (Block &block : cfg_.blocks) {
+    for (IrInst &i : block.code) {
+      uint32_t *ops[2];
+      for (int k = ir_uses(i, ops); k-- > 0;) read[*ops[k]] = 1;
+      if (i.op != IR_PHI) continue;
+      const uint32_t *args = cfg_.phi_args(i);
+      for (size_t k = 0; k < block.preds.size(); k++) read[args[k]] = 1;
+    }
+  }
+  for (Block &block : cfg_.blocks) {
+    block.code.erase(std::remove_if(block.code.begin(), block.code.end(),
+                                    [&](const IrInst &i) { return i.op == IR_LI && !read[i.dst]; }),
+                     block.code.end());
+  }
+}
+
+}  // namespace
+
+void propagate_constants(Cfg &cfg) {
+  Propagation p(cfg);
+  p.run();
+  p.rewrite();
+}
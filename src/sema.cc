@@ -0,0 +1,298 @@
+#include "sema.hh"
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+// read() and write(int) are provided by the runtime; they are declared as
+// function nodes outside the CompUnit so calls resolve like any other.
+Sema::Sema(Ast &ast, bool report) : ast_(ast), report_(report) {
+  NodeId read = ast_.make(N_FUNC_DEF, 0);
+  ast_[read].name = ast_.names.intern("read", 4);
+  ast_[read].flags = F_BUILTIN;
+  declare(read);
+  NodeId param = ast_.make(N_PARAM, 0);
+  ast_[param].name = ast_.names.intern("x", 1);
+  NodeId write = ast_.make(N_FUNC_DEF, 0, param);
+  ast_[write].name = ast_.names.intern("write", 5);
+  ast_[write].flags = F_BUILTIN | F_VOID;
+  declare(write);
+}
+
+void Sema::declare(NodeId decl) {
+  const Node &n = ast_[decl];
+  if (symbols_.declare(n.name, decl)) {
+    error(n.line, "redefinition of %s %s", n.kind == N_FUNC_DEF ? "function" : "variable",
+          ast_.name_of(n.name));
+  }
+}
+
+bool Sema::resolve(NodeId use) {
+  Node &n = ast_[use];
+  n.decl = symbols_.lookup(n.name);
+  if (!n.decl) {
+    error(n.line, "'%s' is not defined", ast_.name_of(n.name));
+  } else if (n.kind == N_CALL && ast_[n.decl].kind != N_FUNC_DEF) {
+    error(n.line, "calling a non-function");
+    n.decl = 0;
+  } else if (n.kind == N_LVAL && ast_[n.decl].kind == N_FUNC_DEF) {
+    error(n.line, "'%s' is a function", ast_.name_of(n.name));
+    n.decl = 0;
+  }
+  return n.decl != 0;
+}
+
+// Append the shape of a declaration with dimensions `dims` (and a leading
+// unsized one if `leading` is 0) to Ast::shapes.
+uint32_t Sema::make_shape(int32_t leading, NodeId dims, int line) {
+  if (leading < 0 && !dims) return 0;
+  uint32_t shape = ast_.shapes.size();
+  ast_.shapes.push_back(0);
+  if (leading >= 0) ast_.shapes.push_back(leading);
+  for (NodeId d = dims; d; d = ast_[d].next) {
+    int32_t size = ast_[d].value;
+    if (!(ast_[d].flags & F_CONST)) {
+      error(line, "array size is not a constant expression");
+      size = 1;
+    } else if (size <= 0) {
+      error(line, "array size must be positive");
+      size = 1;
+    }
+    ast_.shapes.push_back(size);
+  }
+  ast_.shapes[shape] = ast_.shapes.size() - shape - 1;
+  return shape;
+}
+
+void Sema::var_def(NodeId def) {
+  ast_[def].shape = make_shape(-1, ast_[def].a, ast_[def].line);
+  declare(def);
+}
+
+// Checks the initializer and lays it out in Ast::inits at the same time.
+void Sema::var_init(NodeId def) {
+  Node &n = ast_[def];
+  const int32_t *shape = ast_.shape_of(def);
+  // globals and consts need a value at compile time
+  bool constant = symbols_.depth() == 0 || (n.flags & F_CONST);
+  n.value = ast_.inits.size();
+  ast_.inits.push_back(InitElem{0, 0});
+  if (shape[0] > 0) {
+    if (ast_[n.b].kind != N_INIT_LIST) error(n.line, "Array initializer must be an initializer list");
+    else check_init_list(n.b, shape + 1, shape[0], 0, constant);
+  } else {
+    check_scalar_init(n.b, 0, constant);
+  }
+  ast_.inits[n.value].index = ast_.inits.size() - n.value - 1;
+}
+
+// `int a = {1};` is fine too, as are braces around an array element.
+void Sema::check_scalar_init(NodeId init, int64_t index, bool constant) {
+  while (ast_[init].kind == N_INIT_LIST) {
+    const Node &list = ast_[init];
+    if (!list.a) return;
+    if (ast_[list.a].next) {
+      error(ast_[ast_[list.a].next].line, "Excess elements in scalar initializer");
+      return;
+    }
+    init = list.a;
+  }
+  check_init_element(init, constant);
+  // a constant zero is left out like an element the braces left out
+  if (!(ast_[init].flags & F_CONST) || ast_[init].value != 0) ast_.inits.push_back(InitElem{index, init});
+}
+
+void Sema::check_init_element(NodeId e, bool constant) {
+  if (!is_int(e)) {
+    error(ast_[e].line, "Initializing 'int' with an expression of incompatible type '%s'", type_name(e).c_str());
+  } else if (constant && !(ast_[e].flags & F_CONST)) {
+    error(ast_[e].line, "initializer element is not a compile-time constant");
+  }
+}
+
+// Lay out the elements of `list` over an array of `rank` dimensions,
+// starting at element `base` of the variable, the way C does with elided
+// braces: plain elements fill the next slot, and a nested list fills the
+// largest sub-array that starts at the current slot.
+void Sema::check_init_list(NodeId list, const int32_t *dims, int rank, int64_t base, bool constant) {
+  int64_t size = 1;
+  for (int i = 0; i < rank; i++) size *= dims[i];
+  int64_t pos = 0;
+  for (NodeId e = ast_[list].a; e; e = ast_[e].next) {
+    if (pos >= size) {
+      error(ast_[e].line, "Excess elements in array initializer");
+      return;
+    }
+    if (ast_[e].kind != N_INIT_LIST) {
+      check_scalar_init(e, base + pos++, constant);
+      continue;
+    }
+    int i = 1;
+    int64_t stride = size / dims[0];
+    while (i < rank && pos % stride) stride /= dims[i++];
+    if (i == rank) {  // braces around a single element
+      check_scalar_init(e, base + pos++, constant);
+    } else {
+      check_init_list(e, dims + i, rank - i, base + pos, constant);
+      pos += stride;
+    }
+  }
+}
+
+void Sema::param(NodeId param) {
+  ast_[param].shape = make_shape(ast_[param].flags & F_ARRAY ? 0 : -1, ast_[param].a, ast_[param].line);
+  declare(param);
+}
+
+void Sema::begin_function(NodeId func) {
+  declare(func);
+  func_ = func;
+  symbols_.enter();
+}
+
+void Sema::end_function() {
+  symbols_.leave();
+  func_ = 0;
+}
+
+void Sema::number(NodeId num) {
+  ast_[num].type = T_INT;
+  ast_[num].flags |= F_CONST;
+}
+
+void Sema::lval(NodeId lval) {
+  Node &n = ast_[lval];
+  n.type = T_INT;
+  int indices = 0;
+  for (NodeId i = n.a; i; i = ast_[i].next, indices++) {
+    if (!is_int(i)) error(ast_[i].line, "array subscript is not an integer");
+  }
+  if (!resolve(lval)) return;
+  int rank = ast_.shape_of(n.decl)[0];
+  if (indices > rank) {
+    error(n.line, "Subscripting a non-array");
+  } else if (indices < rank) {
+    n.type = T_ARRAY;
+    n.rank = rank - indices;
+  } else {
+    fold_const(lval);
+  }
+}
+
+// A const variable, or an element of a const array at constant indices
+// within bounds, has the value of its initializer.
+void Sema::fold_const(NodeId lval) {
+  Node &n = ast_[lval];
+  const Node &decl = ast_[n.decl];
+  if (decl.kind != N_VAR_DEF || !(decl.flags & F_CONST) || !decl.b) return;
+  const int32_t *shape = ast_.shape_of(n.decl);
+  int64_t pos = 0;
+  int k = 0;
+  for (NodeId i = n.a; i; i = ast_[i].next, k++) {
+    const Node &index = ast_[i];
+    if (!(index.flags & F_CONST) || index.value < 0 || index.value >= shape[1 + k]) return;
+    pos = pos * shape[1 + k] + index.value;
+  }
+  InitRange elems = ast_.init_of(n.decl);
+  const InitElem *e = std::lower_bound(elems.begin(), elems.end(), pos,
+                                       [](const InitElem &e, int64_t pos) { return e.index < pos; });
+  n.value = e != elems.end() && e->index == pos ? ast_[e->exp].value : 0;
+  n.flags |= F_CONST;
+}
+
+void Sema::call(NodeId call) {
+  Node &n = ast_[call];
+  n.type = T_INT;
+  if (!resolve(call)) return;
+  const Node &func = ast_[n.decl];
+  if (func.flags & F_VOID) n.type = T_VOID;
+  NodeId arg = n.a, param = func.a;
+  for (; arg && param; arg = ast_[arg].next, param = ast_[param].next) {
+    const int32_t *want = ast_.shape_of(param);
+    const Node &a = ast_[arg];
+    if (want[0] == 0) {
+      if (a.type != T_INT) error(a.line, "No matching function for call to '%s'", ast_.name_of(n.name));
+      continue;
+    }
+    bool match = a.type == T_ARRAY && a.rank == want[0];
+    if (match) {
+      const int32_t *have = ast_.shape_of(a.decl);
+      have += 1 + (have[0] - a.rank);  // sizes left after the indices
+      for (int i = 1; i < want[0]; i++) match = match && have[i] == want[1 + i];
+    }
+    if (!match) {
+      error(a.line, "Array dimensions not matched, expected '%s' but argument is of type '%s'",
+            param_type_name(param).c_str(), type_name(arg).c_str());
+    }
+  }
+  if (arg || param) error(n.line, "Function arguments not matched");
+}
+
+void Sema::unary(NodeId exp) {
+  Node &n = ast_[exp];
+  n.type = T_INT;
+  const Node &a = ast_[n.a];
+  if (!is_int(n.a)) error(n.line, "Invalid operand to '%s'", type_name(n.a).c_str());
+  else if ((a.flags & F_CONST) && fold_op(n.op, a.value, 0, n.value)) n.flags |= F_CONST;
+}
+
+void Sema::binary(NodeId exp) {
+  Node &n = ast_[exp];
+  n.type = T_INT;
+  const Node &a = ast_[n.a], &b = ast_[n.b];
+  if (!is_int(n.a) || !is_int(n.b))
+    error(n.line, "Invalid operands to '%s' and '%s'", type_name(n.a).c_str(), type_name(n.b).c_str());
+  else if ((a.flags & b.flags & F_CONST) && fold_op(n.op, a.value, b.value, n.value)) n.flags |= F_CONST;
+}
+
+void Sema::assign(NodeId stmt) {
+  const Node &n = ast_[stmt];
+  const Node &lval = ast_[n.a];
+  if (lval.decl && (ast_[lval.decl].flags & F_CONST))
+    error(n.line, "Cannot assign to const variable '%s'", ast_.name_of(lval.name));
+  else if (lval.type == T_ARRAY) error(n.line, "Array type is not assignable");
+  else if (!is_int(n.b))
+    error(n.line, "Assigning to 'int' from incompatible type '%s'", type_name(n.b).c_str());
+}
+
+void Sema::cond(NodeId exp) {
+  if (!is_int(exp)) error(ast_[exp].line, "Condition of type '%s' is not an integer", type_name(exp).c_str());
+}
+
+void Sema::ret(NodeId stmt) {
+  const Node &n = ast_[stmt];
+  if (!func_) return;
+  bool want_value = !(ast_[func_].flags & F_VOID);
+  if (want_value != (n.a != 0) || (n.a && !is_int(n.a))) error(n.line, "Return type mismatch");
+}
+
+std::string Sema::type_name(NodeId exp) const {
+  const Node &n = ast_[exp];
+  if (n.type == T_INT) return "int";
+  if (n.type == T_VOID) return "void";
+  const int32_t *shape = ast_.shape_of(n.decl);
+  std::string name = "int";
+  for (int i = shape[0] - n.rank; i < shape[0]; i++)
+    name += shape[1 + i] ? "[" + std::to_string(shape[1 + i]) + "]" : "[]";
+  return name;
+}
+
+// Parameter types are spelled decayed, the way C reports them.
+std::string Sema::param_type_name(NodeId param) const {
+  const int32_t *shape = ast_.shape_of(param);
+  if (shape[0] == 0) return "int";
+  if (shape[0] == 1) return "int *";
+  std::string name = "int (*)";
+  for (int i = 1; i < shape[0]; i++) name += "[" + std::to_string(shape[1 + i]) + "]";
+  return name;
+}
+
+void Sema::error(int line, const char *fmt, ...) {
+  errors_++;
+  if (!report_) return;
+  fprintf(stderr, "Semantic Error at Line %d: ", line);
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include "ast.hh"
+#include "symtab.hh"
+
+// Semantic analysis, driven by the parser's actions while the tree is
+// built. Each hook runs once, when its node is reduced: declarations are
+// entered into the symbol table, uses are resolved, and every expression
+// gets its type (and its value, if constant) from its already-checked
+// operands. No node is visited twice and there is no separate pass, so
+// checking costs about as much as parsing.
+class Sema {
+ public:
+  // With `report` false, errors are only counted, not printed.
+  explicit Sema(Ast &ast, bool report = true);
+
+  void enter_scope() { symbols_.enter(); }
+  void leave_scope() { symbols_.leave(); }
+
+  // Declarations.
+  void var_def(NodeId def);    // N_VAR_DEF, before its initializer
+  void var_init(NodeId def);   // N_VAR_DEF, once its initializer is in
+  void param(NodeId param);    // N_PARAM
+  void begin_function(NodeId func);
+  void end_function();
+
+  // Expressions.
+  void number(NodeId num);
+  void lval(NodeId lval);
+  void call(NodeId call);
+  void unary(NodeId exp);
+  void binary(NodeId exp);
+
+  // Statements.
+  void assign(NodeId stmt);
+  void cond(NodeId exp);       // condition of N_IF / N_WHILE
+  void ret(NodeId stmt);
+
+  int errors() const { return errors_; }
+
+ private:
+  void declare(NodeId decl);
+  bool resolve(NodeId use);
+  void fold_const(NodeId lval);
+  uint32_t make_shape(int32_t leading, NodeId dims, int line);
+  bool is_int(NodeId exp) const { return ast_[exp].type == T_INT; }
+  std::string type_name(NodeId exp) const;
+  std::string param_type_name(NodeId param) const;
+  void check_init_element(NodeId exp, bool constant);
+  void check_scalar_init(NodeId init, int64_t index, bool constant);
+  void check_init_list(NodeId list, const int32_t *dims, int rank, int64_t base, bool constant);
+  void error(int line, const char *fmt, ...);
+
+  Ast &ast_;
+  SymbolTable symbols_;
+  NodeId func_ = 0;  // function whose body is being parsed
+  bool report_;
+  int errors_ = 0;
+};
@@ -0,0 +1,66 @@
+#include "source.hh"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Source::~Source() {
+  if (map_size_) munmap(data_, map_size_);
+  else free(data_);
+}
+
+bool Source::open(const char *path) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && map(fd, st.st_size);
+  if (!ok) ok = read(fd);
+  close(fd);
+  return ok;
+}
+
+// Reserve zeroed anonymous pages for the file plus its two NULs, then map
+// the file over the front of them. Past the end of the file the last file
+// page reads as zeros, and if the file fills its last page exactly the NULs
+// land in the anonymous page behind it.
+bool Source::map(int fd, size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t len = (size + 2 + page - 1) / page * page;
+  void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) return false;
+  // MAP_POPULATE reads the file in now rather than page by page later.
+  if (mmap(p, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED | MAP_POPULATE, fd, 0) == MAP_FAILED) {
+    munmap(p, len);
+    return false;
+  }
+  data_ = static_cast<char *>(p);
+  size_ = size;
+  map_size_ = len;
+  return true;
+}
+
+// Pipes, empty files and the like: read everything into a malloc'd buffer.
+bool Source::read(int fd) {
+  size_t cap = 64 * 1024, len = 0;
+  char *buf = static_cast<char *>(malloc(cap));
+  for (;;) {
+    if (cap - len < 4096) {
+      cap *= 2;
+      char *bigger = static_cast<char *>(realloc(buf, cap));
+      if (!bigger) break;
+      buf = bigger;
+    }
+    ssize_t n = ::read(fd, buf + len, cap - len - 2);
+    if (n < 0) break;
+    if (n == 0) {
+      buf[len] = buf[len + 1] = '\0';
+      data_ = buf;
+      size_ = len;
+      return true;
+    }
+    len += n;
+  }
+  free(buf);
+  return false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <string_view>
+
+// A source file held in memory and followed by two NUL bytes, the layout
+// flex's yy_scan_buffer scans in place. Regular files are mapped
+// copy-on-write, so the scanner may write into the buffer (it terminates
+// yytext in place) without touching the file; anything that cannot be
+// mapped is read in one go instead. Identifiers and diagnostics can keep
+// string_views into text() for as long as the Source lives.
+class Source {
+ public:
+  Source() = default;
+  ~Source();
+  Source(const Source &) = delete;
+  Source &operator=(const Source &) = delete;
+
+  // Returns false (with errno set) when the file cannot be opened or read.
+  bool open(const char *path);
+
+  char *data() const { return data_; }
+  size_t size() const { return size_; }
+  std::string_view text() const { return std::string_view(data_, size_); }
+
+ private:
+  bool map(int fd, size_t size);
+  bool read(int fd);
+
+  char *data_ = nullptr;
+  size_t size_ = 0;
+  size_t map_size_ = 0;  // nonzero when data_ is a mapping
+};
@@ -0,0 +1,389 @@
+#include "ssa.hh"
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include "cfg.hh"
+#include "dominance.hh"
+
+namespace {
+
+typedef std::pair<uint32_t, uint32_t> Copy;  // dst, src
+
+size_t index_of(const std::vector<uint32_t> &list, uint32_t x) {
+  return std::find(list.begin(), list.end(), x) - list.begin();
+}
+
+void place_phis(Cfg &cfg, const DomTree &dom) {
+  uint32_t values = cfg.f.values.size();
+  uint32_t blocks = cfg.blocks.size();
+  // Values read in a block before any assignment there are the only ones
+  // that can need a phi.
+  std::vector<uint32_t> killed(values, UINT32_MAX);
+  std::vector<char> crosses(values);
+  std::vector<std::pair<uint32_t, uint32_t>> defs;  // value, block
+  for (uint32_t b = 0; b < blocks; b++) {
+    for (IrInst &i : cfg.blocks[b].code) {
+      uint32_t *ops[2];
+      for (int k = ir_uses(i, ops); k-- > 0;) crosses[*ops[k]] |= killed[*ops[k]] != b;
+      if (ir_defines(i) && killed[i.dst] != b) {
+        killed[i.dst] = b;
+        defs.push_back({i.dst, b});
+      }
+    }
+  }
+  std::sort(defs.begin(), defs.end());
+
+  std::vector<std::vector<uint32_t>> df = dom.frontiers(cfg);
+  std::vector<uint32_t> has_phi(blocks, UINT32_MAX), queued(blocks, UINT32_MAX), work;
+  for (size_t d = 0; d < defs.size();) {
+    uint32_t v = defs[d].first;
+    for (; d < defs.size() && defs[d].first == v; d++) {
+      if (!crosses[v]) continue;
+      queued[defs[d].second] = v;
+      work.push_back(defs[d].second);
+    }
+    while (!work.empty()) {
+      uint32_t b = work.back();
+      work.pop_back();
+      for (uint32_t j : df[b]) {
+        if (has_phi[j] == v) continue;
+        has_phi[j] = v;
+        cfg.add_phi(j, v);
+        if (queued[j] != v) {
+          queued[j] = v;
+          work.push_back(j);
+        }
+      }
+    }
+  }
+}
+
+// Renaming: cur[v] is the version of v that reaches the current point of
+// the walk; entering a block logs what it replaces, leaving undoes it.
+void rename(Cfg &cfg, const DomTree &dom) {
+  IrFunction &f = cfg.f;
+  uint32_t values = f.values.size();
+  cfg.origin.resize(values);
+  for (uint32_t v = 0; v < values; v++) cfg.origin[v] = v;
+  std::vector<uint32_t> cur(values);
+  std::vector<char> taken(values);
+  std::vector<Copy> log;  // value, version it had
+  uint32_t undef = 0;
+  auto read = [&](uint32_t v) {
+    if (cur[v]) return cur[v];
+    if (!undef) undef = f.new_temp();
+    return undef;
+  };
+
+  const uint32_t leave = 1u << 31;
+  std::vector<size_t> mark(cfg.blocks.size());
+  std::vector<uint32_t> todo{0};
+  while (!todo.empty()) {
+    uint32_t b = todo.back();
+    todo.pop_back();
+    if (b & leave) {
+      for (b &= ~leave; log.size() > mark[b]; log.pop_back()) cur[log.back().first] = log.back().second;
+      continue;
+    }
+    mark[b] = log.size();
+    for (IrInst &i : cfg.blocks[b].code) {
+      uint32_t *ops[2];
+      for (int k = ir_uses(i, ops); k-- > 0;) *ops[k] = read(*ops[k]);
+      if (!ir_defines(i)) continue;
+      uint32_t v = i.op == IR_PHI ? i.b : i.dst;
+      uint32_t version = v;
+      if (taken[v]) {
+        version = f.new_temp();
+        while (cfg.origin.size() < f.values.size()) cfg.origin.push_back(cfg.origin.size());
+        cfg.origin[version] = v;
+      }
+      taken[v] = 1;
+      log.push_back({v, cur[v]});
+      cur[v] = version;
+      i.dst = version;
+    }
+    for (uint32_t s : cfg.blocks[b].succs) {
+      size_t k = index_of(cfg.blocks[s].preds, b);
+      for (const IrInst &phi : cfg.blocks[s].code) {
+        if (phi.op != IR_PHI) break;
+        cfg.phi_args(phi)[k] = read(phi.b);
+      }
+    }
+    todo.push_back(b | leave);
+    for (const uint32_t *c = dom.children_end(b); c != dom.children_begin(b);) todo.push_back(*--c);
+  }
+
+  if (undef) {
+    std::vector<IrInst> &entry = cfg.blocks[0].code;
+    auto at = std::find_if(entry.begin(), entry.end(), [](const IrInst &i) { return i.op != IR_PHI && i.op != IR_PARAM; });
+    entry.insert(at, IrInst{IR_LI, 0, undef, 0, 0, 0});
+  }
+}
+
+// Drop the phis whose value reaches no other instruction.
+void prune_phis(Cfg &cfg) {
+  std::vector<const IrInst *> phi_of(cfg.f.values.size());
+  std::vector<uint32_t> arity(cfg.f.values.size());
+  std::vector<char> live(cfg.f.values.size());
+  std::vector<uint32_t> work;
+  auto use = [&](uint32_t v) {
+    if (!live[v]) {
+      live[v] = 1;
+      work.push_back(v);
+    }
+  };
+  for (Block &block : cfg.blocks) {
+    for (IrInst &i : block.code) {
+      if (i.op == IR_PHI) {
+        phi_of[i.dst] = &i;
+        arity[i.dst] = block.preds.size();
+        continue;
+      }
+      uint32_t *ops[2];
+      for (int k = ir_uses(i, ops); k-- > 0;) use(*ops[k]);
+    }
+  }
+  while (!work.empty()) {
+    uint32_t v = work.back();
+    work.pop_back();
+    if (!phi_of[v]) continue;
+    const uint32_t *args = cfg.phi_args(*phi_of[v]);
+    for (uint32_t k = 0; k < arity[v]; k++) use(args[k]);
+  }
+  for (Block &block : cfg.blocks) {
+    block.code.erase(std::remove_if(block.code.begin(), block.code.end(),
+                                    [&](const IrInst &i) { return i.op == IR_PHI && !live[i.dst]; }),
+                     block.code.end());
+  }
+}
+
+// Where each value is assigned and read, to tell whether two values are
+// needed at the same time. Only for SSA code: every value has one
+// assignment, and it dominates the value's uses.
+class Liveness {
+ public:
+  explicit Liveness(Cfg &cfg);
+
+  uint32_t def_block(uint32_t v) const { return def_block_[v]; }
+  uint32_t def_index(uint32_t v) const { return def_index_[v]; }
+  // Whether `v` is still needed after instruction `index` of `block`,
+  // a point its assignment dominates.
+  bool live_after(uint32_t v, uint32_t block, uint32_t index);
+
+ private:
+  static const uint32_t edge = UINT32_MAX;  // use index of a phi operand
+
+  const std::vector<uint32_t> &live_in(uint32_t v);
+
+  Cfg &cfg_;
+  std::vector<uint32_t> def_block_, def_index_;
+  std::vector<uint32_t> use_start_;
+  std::vector<Copy> uses_;  // block, index; a phi operand is read at the
+                            // end of the predecessor it comes from
+  std::unordered_map<uint32_t, std::vector<uint32_t>> live_in_;  // sorted
+  std::vector<uint32_t> seen_;
+  uint32_t visit_ = 0;
+};
+
+Liveness::Liveness(Cfg &cfg) : cfg_(cfg), seen_(cfg.blocks.size()) {
+  uint32_t values = cfg.f.values.size();
+  def_block_.assign(values, UINT32_MAX);
+  def_index_.assign(values, 0);
+  use_start_.assign(values + 1, 0);
+  // counting pass, then filling pass
+  for (int fill = 0; fill < 2; fill++) {
+    for (uint32_t b = 0; b < cfg.blocks.size(); b++) {
+      Block &block = cfg.blocks[b];
+      for (uint32_t n = 0; n < block.code.size(); n++) {
+        IrInst &i = block.code[n];
+        if (!fill && ir_defines(i)) {
+          def_block_[i.dst] = b;
+          def_index_[i.dst] = n;
+        }
+        uint32_t *ops[2];
+        for (int k = ir_uses(i, ops); k-- > 0;) {
+          if (fill) uses_[use_start_[*ops[k]]++] = {b, n};
+          else use_start_[*ops[k] + 1]++;
+        }
+        if (i.op != IR_PHI) continue;
+        const uint32_t *args = cfg.phi_args(i);
+        for (size_t k = 0; k < block.preds.size(); k++) {
+          if (fill) uses_[use_start_[args[k]]++] = {block.preds[k], edge};
+          else use_start_[args[k] + 1]++;
+        }
+      }
+    }
+    if (fill) break;
+    for (uint32_t v = 0; v < values; v++) use_start_[v + 1] += use_start_[v];
+    uses_.resize(use_start_[values]);
+  }
+  // the filling pass moved every start to the next value's start
+  for (uint32_t v = values; v > 0; v--) use_start_[v] = use_start_[v - 1];
+  use_start_[0] = 0;
+}
+
+// Blocks `v` is live on entry to, found by walking back from its uses to
+// its assignment.
+const std::vector<uint32_t> &Liveness::live_in(uint32_t v) {
+  auto [it, added] = live_in_.try_emplace(v);
+  std::vector<uint32_t> &in = it->second;
+  if (!added) return in;
+  visit_++;
+  std::vector<uint32_t> work;
+  auto enter = [&](uint32_t b) {
+    if (b == def_block_[v] || seen_[b] == visit_) return;
+    seen_[b] = visit_;
+    in.push_back(b);
+    work.push_back(b);
+  };
+  for (uint32_t u = use_start_[v]; u < use_start_[v + 1]; u++) enter(uses_[u].first);
+  while (!work.empty()) {
+    uint32_t b = work.back();
+    work.pop_back();
+    for (uint32_t p : cfg_.blocks[b].preds) enter(p);
+  }
+  std::sort(in.begin(), in.end());
+  return in;
+}
+
+bool Liveness::live_after(uint32_t v, uint32_t block, uint32_t index) {
+  for (uint32_t u = use_start_[v]; u < use_start_[v + 1]; u++) {
+    if (uses_[u].first == block && uses_[u].second > index) return true;
+  }
+  const std::vector<uint32_t> &in = live_in(v);
+  for (uint32_t s : cfg_.blocks[block].succs) {
+    if (std::binary_search(in.begin(), in.end(), s)) return true;
+  }
+  return false;
+}
+
+// Give all versions of a value the original's number again where none of
+// them is needed while another is assigned, so phi copies between them
+// become copies of a value to itself and source names come back. Right after to_ssa that
+// holds for every value; optimizations that move code or reuse values
+// can break it, and the versions of such a value keep their numbers.
+//
+// Versions are checked in dominance order against the nearest version
+// whose assignment dominates theirs: if any two of them overlap, some
+// such pair does (Budimlic et al., "Fast Copy Coalescing and Live-Range
+// Identification").
+void coalesce(Cfg &cfg, const DomTree &dom) {
+  uint32_t values = cfg.f.values.size();
+  std::vector<char> versioned(values);
+  for (uint32_t v = 1; v < values; v++) {
+    if (cfg.origin_of(v) != v) versioned[cfg.origin_of(v)] = 1;
+  }
+  Liveness live(cfg);
+  std::vector<uint32_t> pre(cfg.blocks.size());
+  for (uint32_t k = 0; k < pre.size(); k++) pre[dom.preorder()[k]] = k;
+  struct Member {
+    uint32_t origin, pre, index, value;
+    bool operator<(const Member &m) const {
+      return std::tie(origin, pre, index) < std::tie(m.origin, m.pre, m.index);
+    }
+  };
+  std::vector<Member> members;
+  for (uint32_t v = 1; v < values; v++) {
+    uint32_t o = cfg.origin_of(v);
+    if (versioned[o] && live.def_block(v) != UINT32_MAX) {
+      members.push_back({o, pre[live.def_block(v)], live.def_index(v), v});
+    }
+  }
+  std::sort(members.begin(), members.end());
+
+  std::vector<uint32_t> rep(values);
+  for (uint32_t v = 0; v < values; v++) rep[v] = v;
+  std::vector<const Member *> stack;
+  for (size_t m = 0; m < members.size();) {
+    size_t end = m;
+    while (end < members.size() && members[end].origin == members[m].origin) end++;
+    bool overlap = false;
+    stack.clear();
+    for (size_t k = m; k < end && !overlap; k++) {
+      const Member &x = members[k];
+      uint32_t xb = live.def_block(x.value);
+      while (!stack.empty() && !dom.dominates(live.def_block(stack.back()->value), xb)) stack.pop_back();
+      if (!stack.empty()) overlap = live.live_after(stack.back()->value, xb, x.index);
+      stack.push_back(&x);
+    }
+    for (; m < end; m++) {
+      if (!overlap) rep[members[m].value] = members[m].origin;
+    }
+  }
+
+  for (Block &block : cfg.blocks) {
+    for (IrInst &i : block.code) {
+      uint32_t *ops[2];
+      for (int k = ir_uses(i, ops); k-- > 0;) *ops[k] = rep[*ops[k]];
+      if (ir_defines(i)) i.dst = rep[i.dst];
+      if (i.op != IR_PHI) continue;
+      uint32_t *args = cfg.phi_args(i);
+      for (size_t k = 0; k < block.preds.size(); k++) args[k] = rep[args[k]];
+    }
+  }
+}
+
+// Append the parallel copies `copies` to `out` as a sequence of moves.
+void sequentialize(IrFunction &f, std::vector<Copy> &copies, std::vector<IrInst> &out) {
+  copies.erase(std::remove_if(copies.begin(), copies.end(), [](const Copy &c) { return c.first == c.second; }),
+               copies.end());
+  while (!copies.empty()) {
+    bool progress = false;
+    for (size_t i = 0; i < copies.size();) {
+      uint32_t dst = copies[i].first;
+      bool read = std::any_of(copies.begin(), copies.end(), [&](const Copy &c) { return c.second == dst; });
+      if (read) {
+        i++;
+        continue;
+      }
+      out.push_back(IrInst{IR_MOV, 0, dst, copies[i].second, 0, 0});
+      copies.erase(copies.begin() + i);
+      progress = true;
+    }
+    if (progress) continue;
+    // Only cycles are left: save one destination's old value and let the
+    // copies reading it read the saved one.
+    uint32_t dst = copies[0].first, saved = f.new_temp();
+    out.push_back(IrInst{IR_MOV, 0, saved, dst, 0, 0});
+    for (Copy &c : copies) {
+      if (c.second == dst) c.second = saved;
+    }
+  }
+}
+
+}  // namespace
+
+void to_ssa(Cfg &cfg, const DomTree &dom) {
+  place_phis(cfg, dom);
+  rename(cfg, dom);
+  prune_phis(cfg);
+}
+
+void from_ssa(Cfg &cfg, const DomTree &dom) {
+  coalesce(cfg, dom);
+  std::vector<Copy> copies;
+  std::vector<IrInst> moves;
+  uint32_t n = cfg.blocks.size();  // blocks split off below have no phis
+  for (uint32_t b = 0; b < n; b++) {
+    if (cfg.blocks[b].code.front().op != IR_PHI) continue;
+    size_t phis = 0;
+    while (cfg.blocks[b].code[phis].op == IR_PHI) phis++;
+    for (size_t k = 0; k < cfg.blocks[b].preds.size(); k++) {
+      copies.clear();
+      for (size_t i = 0; i < phis; i++) {
+        const IrInst &phi = cfg.blocks[b].code[i];
+        copies.push_back({phi.dst, cfg.phi_args(phi)[k]});
+      }
+      moves.clear();
+      sequentialize(cfg.f, copies, moves);
+      if (moves.empty()) continue;
+      uint32_t p = cfg.blocks[b].preds[k];
+      if (cfg.blocks[p].succs.size() > 1) p = cfg.split_edge(p, index_of(cfg.blocks[p].succs, b));
+      std::vector<IrInst> &pred = cfg.blocks[p].code;
+      pred.insert(pred.end() - 1, moves.begin(), moves.end());
+    }
+    std::vector<IrInst> &code = cfg.blocks[b].code;
+    code.erase(code.begin(), code.begin() + phis);
+  }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+class Cfg;
+class DomTree;
+
+// SSA form of a Cfg, and the way back to the flat code ir.py runs.
+//
+// to_ssa() gives every assignment a value of its own. Phis go at the
+// iterated dominance frontiers of the blocks assigning a value that is
+// read in some other block (semi-pruned SSA), uses are renamed in one walk
+// over the dominator tree, and phis nothing reads are dropped. The first
+// assignment of a value keeps its number, and with it its source name; the
+// others get new temporaries. A read that no assignment reaches on some
+// path reads 0, which is one of the values an uninitialized local may hold.
+void to_ssa(Cfg &cfg, const DomTree &dom);
+
+// Replace the phis by copies at the end of their predecessors. Versions
+// of one value that never overlap share a number again first, which makes
+// most copies vanish. Critical edges are split, so the copies run only on
+// the edge they belong to, and the copies on one edge are ordered (through
+// a temporary where they form a cycle) so that none overwrites a value
+// another still reads. `dom` must be the Cfg's current dominator tree.
+void from_ssa(Cfg &cfg, const DomTree &dom);
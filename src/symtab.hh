@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "ast.hh"
+
+// Block-scoped map from interned name to its declaration node.
+//
+// Names are dense interner IDs, so the "hash" is a plain vector indexed by
+// name that holds the innermost binding of each name. Bindings live on one
+// stack; each remembers the binding it shadows. Entering a scope records
+// the stack height and leaving it pops back to that mark, restoring the
+// shadowed bindings on the way. Lookup is O(1), and every binding is
+// pushed and popped once, so resolving a whole unit is linear in its size
+// however deeply its blocks nest.
+class SymbolTable {
+ public:
+  void enter() { marks_.push_back(bindings_.size()); }
+
+  void leave() {
+    uint32_t mark = marks_.back();
+    marks_.pop_back();
+    while (bindings_.size() > mark) {
+      const Binding &b = bindings_.back();
+      innermost_[b.name] = b.shadowed;
+      bindings_.pop_back();
+    }
+  }
+
+  // Bind `name` to `decl` in the innermost scope, unless the name is
+  // already declared in that same scope. Returns the existing declaration
+  // in that case and 0 otherwise.
+  NodeId declare(uint32_t name, NodeId decl) {
+    if (name >= innermost_.size()) innermost_.resize(name + 1, none);
+    int32_t top = innermost_[name];
+    uint32_t scope_start = marks_.empty() ? 0 : marks_.back();
+    if (top != none && (uint32_t)top >= scope_start) return bindings_[top].decl;
+    innermost_[name] = bindings_.size();
+    bindings_.push_back(Binding{name, decl, top});
+    return 0;
+  }
+
+  // Innermost declaration of `name`, or 0 if it is not in scope.
+  NodeId lookup(uint32_t name) const {
+    if (name >= innermost_.size() || innermost_[name] == none) return 0;
+    return bindings_[innermost_[name]].decl;
+  }
+
+  // Number of open scopes; the outermost (global) scope is depth 0.
+  int depth() const { return marks_.size(); }
+
+ private:
+  static constexpr int32_t none = -1;
+
+  struct Binding {
+    uint32_t name;
+    NodeId decl;
+    int32_t shadowed;  // binding of the same name this one hides, or none
+  };
+
+  std::vector<int32_t> innermost_;  // by name
+  std::vector<Binding> bindings_;
+  std::vector<uint32_t> marks_;     // bindings_.size() at each enter()
+};
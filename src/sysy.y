@@ -2,136 +2,226 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-void yyerror(const char *s);
-extern int yylex(void);
+#include "ast.hh"
 %}
 
-%token INT 
-%token IDENT
-%token ADD MUL SUB DIV
-%token LPAREN RPAREN LB RB OB CB 
-%token AND OR NOT 
-%token EQ NE LT GT LE GE
-%token ASSIGN
-
-%token SEMI COLON COMMA
-%token IF ELSE WHILE FOR BREAK CONTINUE RETURN MAIN
-
-
-%left OR
-%left AND
-%left EQ NE
-%left LT GT LE GE 
-%right NOT
-
-
-
-%start CompUnit
-%% 
-
-CompUnit :  Decl {printf("Decl Success!");}
-    |       FuncDef {printf("FuncDef Success!");}
-    |       CompUnit FuncDef 
-    |       CompUnit Decl;
-    
-    
+%code requires {
+#include "ast.hh"
+#include "lexer.hh"
+#include "sema.hh"
+}
 
-Decl :      VarDecl;
-VarDecl :   BType VarDef SEMI
-    |       BType LVal SEMI;
-VarDef :    IDENT
-    |       IDENT ASSIGN Exp2
+%code provides {
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
+void yyerror(YYLTYPE *loc, yyscan_t scanner, Ast &ast, Sema &sema, const char *s);
+}
 
+%define api.pure full
+%lex-param { yyscan_t scanner }
+%parse-param { yyscan_t scanner } { Ast &ast } { Sema &sema }
+%locations
+%define parse.error verbose
+
+%union {
+    int num;
+    uint32_t name;
+    NodeId node;
+    NodeList list;
+}
 
-FuncDef: BType MAIN LPAREN RPAREN Block
-    |    BType MAIN LPAREN FuncFParams RPAREN Block
-    |    BType IDENT LPAREN RPAREN Block
-    |    BType IDENT LPAREN FuncFParams RPAREN Block;
+%token CONST INT VOID
+%token <num> INTCONST
+%token <name> IDENT
+%token ADD MUL SUB DIV MOD
+%token LPAREN RPAREN LB RB OB CB
+%token AND OR NOT
+%token EQ NE LT GT LE GE
+%token ASSIGN
 
-FuncFParams : FuncFParam
-    | FuncFParams COMMA FuncFParam;
-FuncFParam : BType IDENT 
-    | BType IDENT LB Calc RB;
+%token SEMI COMMA
+%token IF ELSE WHILE BREAK CONTINUE RETURN
+%token UNKNOWN "invalid character"
 
-Params : Param
-    | Params COMMA Param;
-Param  : LOrExp {$$=$1;};
+%nonassoc LOWER_THAN_ELSE
+%nonassoc ELSE
 
+%type <list> CompUnit VarDefs ConstDefs Dims InitVals FuncFParams BlockItems FuncRParams
+%type <node> Decl VarDecl VarDef VarDefHead ConstDecl ConstDef ConstDefHead InitVal FuncDef FuncSig FuncHead FuncFParam Block FuncBody BlockItem Stmt
+%type <node> Exp Cond LVal PrimaryExp UnaryExp MulExp AddExp RelExp EqExp LAndExp LOrExp
+%type <num> UnaryOp
 
-Block : OB CB {} 
-    | OB BlockGroup CB {};
+%start Program
+%%
 
-BlockGroup : BlockItem
-    | BlockGroup BlockItem {};
+Program : CompUnit { ast.root = ast.make(N_COMP_UNIT, 1, $1.head); };
+
+CompUnit :  Decl { $$ = ast.list($1); }
+    |       FuncDef { $$ = ast.list($1); }
+    |       CompUnit FuncDef { $$ = ast.append($1, $2); }
+    |       CompUnit Decl { $$ = ast.append($1, $2); };
+
+Decl :      VarDecl | ConstDecl;
+VarDecl :   BType VarDefs SEMI { $$ = ast.make(N_VAR_DECL, @1.first_line, $2.head); };
+VarDefs :   VarDef { $$ = ast.list($1); }
+    |       VarDefs COMMA VarDef { $$ = ast.append($1, $3); };
+VarDef :    VarDefHead
+    |       VarDefHead ASSIGN InitVal { $$ = $1; ast[$$].b = $3; sema.var_init($$); };
+// 变量在初始化表达式之前就已进入作用域
+VarDefHead : IDENT Dims {
+                $$ = ast.make(N_VAR_DEF, @1.first_line, $2.head);
+                ast[$$].name = $1;
+                sema.var_def($$);
+            };
+ConstDecl : CONST BType ConstDefs SEMI { $$ = ast.make(N_VAR_DECL, @1.first_line, $3.head); };
+ConstDefs : ConstDef { $$ = ast.list($1); }
+    |       ConstDefs COMMA ConstDef { $$ = ast.append($1, $3); };
+ConstDef :  ConstDefHead ASSIGN InitVal { $$ = $1; ast[$$].b = $3; sema.var_init($$); };
+ConstDefHead : IDENT Dims {
+                $$ = ast.make(N_VAR_DEF, @1.first_line, $2.head);
+                ast[$$].name = $1;
+                ast[$$].flags = F_CONST;
+                sema.var_def($$);
+            };
+Dims :      { $$ = ast.list(); }
+    |       Dims LB Exp RB { $$ = ast.append($1, $3); };
+
+InitVal :   Exp
+    |       OB CB { $$ = ast.make(N_INIT_LIST, @1.first_line); }
+    |       OB InitVals CB { $$ = ast.make(N_INIT_LIST, @1.first_line, $2.head); };
+InitVals :  InitVal { $$ = ast.list($1); }
+    |       InitVals COMMA InitVal { $$ = ast.append($1, $3); };
+
+
+// 函数名在函数体之前声明（允许递归），参数与函数体最外层共用一个作用域
+FuncDef: FuncSig FuncBody {
+            $$ = $1;
+            ast[$$].b = $2;
+            sema.end_function();
+        };
+
+FuncSig: FuncHead RPAREN
+    |    FuncHead FuncFParams RPAREN { $$ = $1; ast[$$].a = $2.head; };
+
+FuncHead: BType IDENT LPAREN {
+            $$ = ast.make(N_FUNC_DEF, @2.first_line);
+            ast[$$].name = $2;
+            sema.begin_function($$);
+        }
+    |    VOID IDENT LPAREN {
+            $$ = ast.make(N_FUNC_DEF, @2.first_line);
+            ast[$$].name = $2;
+            ast[$$].flags = F_VOID;
+            sema.begin_function($$);
+        };
+
+FuncFParams : FuncFParam { $$ = ast.list($1); }
+    | FuncFParams COMMA FuncFParam { $$ = ast.append($1, $3); };
+FuncFParam : BType IDENT {
+                $$ = ast.make(N_PARAM, @2.first_line);
+                ast[$$].name = $2;
+                sema.param($$);
+            }
+    | BType IDENT LB RB Dims {
+                $$ = ast.make(N_PARAM, @2.first_line, $5.head);
+                ast[$$].name = $2;
+                ast[$$].flags = F_ARRAY;
+                sema.param($$);
+            };
+
+
+Block : OB { sema.enter_scope(); } BlockItems CB {
+            $$ = ast.make(N_BLOCK, @1.first_line, $3.head);
+            sema.leave_scope();
+        };
+FuncBody : OB BlockItems CB { $$ = ast.make(N_BLOCK, @1.first_line, $2.head); };
+
+BlockItems : { $$ = ast.list(); }
+    | BlockItems BlockItem { $$ = ast.append($1, $2); };
 
 BlockItem: Decl | Stmt;
 
-Stmt : LVal ASSIGN Exp SEMI
-    | BType LVal SEMI
-    | Exp SEMI
-    | SEMI
+Stmt : LVal ASSIGN Exp SEMI { $$ = ast.make(N_ASSIGN, @2.first_line, $1, $3); sema.assign($$); }
+    | Exp SEMI { $$ = ast.make(N_EXP_STMT, @1.first_line, $1); }
+    | SEMI { $$ = ast.make(N_EMPTY, @1.first_line); }
     | Block
-    | IF LPAREN Cond RPAREN Stmt
-    | IF LPAREN Cond RPAREN Stmt ELSE Stmt
-    | BREAK SEMI
-    | CONTINUE SEMI
-    | RETURN SEMI
-    | RETURN Exp SEMI
-    | IDENT ASSIGN Exp SEMI
-    | Exp ASSIGN  IDENT SEMI
-    | IDENT LPAREN Params RPAREN SEMI;
-
-LVal : IDENT 
-    | IDENT ArrayList;
-
-ArrayList : LB Exp RB 
-    | ArrayList LB Exp RB;
-
-Cond : LOrExp {$$=$1;};
-
-LOrExp : LAndExp {$$ = $1;}
-    |    LOrExp OR LAndExp;
-
-LAndExp : EqExp {$$ = $1;}
-    |    LAndExp AND EqExp;
-
-EqExp : RelExp {$$=$1;}
-    | EqExp EQ RelExp 
-    | EqExp NE RelExp ;
-
-RelExp : Exp {$$=$1;}
-       | RelExp LT Exp 
-       | RelExp GT Exp
-       | RelExp LE Exp 
-       | RelExp GE Exp 
-       | IDENT LPAREN Params RPAREN;
-
-
-
+    | IF LPAREN Cond RPAREN Stmt %prec LOWER_THAN_ELSE { $$ = ast.make(N_IF, @1.first_line, $3, $5); }
+    | IF LPAREN Cond RPAREN Stmt ELSE Stmt { $$ = ast.make(N_IF, @1.first_line, $3, $5, $7); }
+    | WHILE LPAREN Cond RPAREN Stmt { $$ = ast.make(N_WHILE, @1.first_line, $3, $5); }
+    | BREAK SEMI { $$ = ast.make(N_BREAK, @1.first_line); }
+    | CONTINUE SEMI { $$ = ast.make(N_CONTINUE, @1.first_line); }
+    | RETURN SEMI { $$ = ast.make(N_RETURN, @1.first_line); sema.ret($$); }
+    | RETURN Exp SEMI { $$ = ast.make(N_RETURN, @1.first_line, $2); sema.ret($$); };
+
+LVal : IDENT Dims {
+            $$ = ast.make(N_LVAL, @1.first_line, $2.head);
+            ast[$$].name = $1;
+            sema.lval($$);
+        };
+
+Cond : LOrExp { $$ = $1; sema.cond($$); };
+
+LOrExp : LAndExp
+    |    LOrExp OR LAndExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_OR; sema.binary($$); };
+
+LAndExp : EqExp
+    |    LAndExp AND EqExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_AND; sema.binary($$); };
+
+EqExp : RelExp
+    | EqExp EQ RelExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_EQ; sema.binary($$); }
+    | EqExp NE RelExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_NE; sema.binary($$); };
+
+RelExp : AddExp
+       | RelExp LT AddExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_LT; sema.binary($$); }
+       | RelExp GT AddExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_GT; sema.binary($$); }
+       | RelExp LE AddExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_LE; sema.binary($$); }
+       | RelExp GE AddExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_GE; sema.binary($$); };
 
 BType :     INT {};
 
-Calc : 
-    | Exp { printf("= %d\n", $1); }
-    ;
-
-Exp : Exp1 { $$ = $1; }
-    | Exp ADD Exp1 { $$ = $1 + $3; }
-    | Exp SUB Exp1  { $$ = $1 - $3; } 
-    ;
-    
-Exp1 : Exp2 {$$ = $1;}
-    | Exp1 MUL Exp2 { $$ = $1 * $3; } 
-    | Exp1 DIV Exp2 { $$ = $1 / $3; } 
-    ;
-
-Exp2: INT { $$ = $1; }
-    | IDENT {$$ = $1;}
-    | SUB INT  {$$ = (-1)*$1; }
+Exp : AddExp;
+
+AddExp : MulExp
+    | AddExp ADD MulExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_ADD; sema.binary($$); }
+    | AddExp SUB MulExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_SUB; sema.binary($$); };
+
+MulExp : UnaryExp
+    | MulExp MUL UnaryExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_MUL; sema.binary($$); }
+    | MulExp DIV UnaryExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_DIV; sema.binary($$); }
+    | MulExp MOD UnaryExp { $$ = ast.make(N_BINARY, @2.first_line, $1, $3); ast[$$].op = OP_MOD; sema.binary($$); };
+
+UnaryExp : PrimaryExp
+    | IDENT LPAREN RPAREN {
+            $$ = ast.make(N_CALL, @1.first_line);
+            ast[$$].name = $1;
+            sema.call($$);
+        }
+    | IDENT LPAREN FuncRParams RPAREN {
+            $$ = ast.make(N_CALL, @1.first_line, $3.head);
+            ast[$$].name = $1;
+            sema.call($$);
+        }
+    | UnaryOp UnaryExp { $$ = ast.make(N_UNARY, @1.first_line, $2); ast[$$].op = $1; sema.unary($$); };
+
+UnaryOp : ADD { $$ = OP_POS; }
+    | SUB { $$ = OP_NEG; }
+    | NOT { $$ = OP_NOT; };
+
+FuncRParams : Exp { $$ = ast.list($1); }
+    | FuncRParams COMMA Exp { $$ = ast.append($1, $3); };
+
+PrimaryExp: INTCONST {
+            $$ = ast.make(N_NUMBER, @1.first_line);
+            ast[$$].value = $1;
+            sema.number($$);
+        }
+    | LVal
     | LPAREN Exp RPAREN { $$ = $2; }  // 括号表达式
     ;
 %%
 
-void yyerror(const char *s) {
-    printf("error: %s\n", s);
+void yyerror(YYLTYPE *loc, yyscan_t scanner, Ast &ast, Sema &sema, const char *s) {
+    (void)scanner;
+    (void)ast;
+    (void)sema;
+    fprintf(stderr, "Syntax Error at Line %d: %s\n", loc->first_line, s);
 }
@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// Token trace written by the lexer for --dump-tokens. Tokens are appended
+// to a large in-memory buffer that only goes to the output when it fills
+// up or is flushed, so tracing costs one memcpy per token. When tracing is
+// off the lexer does not touch it at all.
+class TokenDump {
+ public:
+  explicit TokenDump(FILE *out = stdout) : out_(out) {}
+  ~TokenDump() { flush(); }
+
+  void put(const char *text, size_t len) {
+    if (len_ + len > sizeof buf_) flush();
+    memcpy(buf_ + len_, text, len);
+    len_ += len;
+  }
+
+  void flush() {
+    if (len_) fwrite(buf_, 1, len_, out_);
+    len_ = 0;
+  }
+
+ private:
+  FILE *out_;
+  size_t len_ = 0;
+  char buf_[1 << 20];
+};
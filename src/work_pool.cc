@@ -0,0 +1,86 @@
+#include "work_pool.hh"
+
+static thread_local bool in_pool = false;
+
+WorkPool::WorkPool(unsigned threads)
+    : nqueues_(threads ? threads : 1), queues_(new Queue[nqueues_]) {
+  for (unsigned i = 1; i < nqueues_; i++) threads_.emplace_back(&WorkPool::loop, this, i);
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : threads_) t.join();
+}
+
+void WorkPool::run(size_t n, const std::function<void(size_t)> &fn) {
+  if (in_pool || nqueues_ == 1 || n <= 1) {
+    for (size_t i = 0; i < n; i++) fn(i);
+    return;
+  }
+  for (unsigned q = 0; q < nqueues_; q++) {
+    std::lock_guard<std::mutex> lock(queues_[q].mutex);
+    for (size_t i = n * q / nqueues_; i < n * (q + 1) / nqueues_; i++) queues_[q].tasks.push_back(i);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    busy_ = nqueues_ - 1;
+    generation_++;
+  }
+  wake_.notify_all();
+  in_pool = true;
+  work(0);
+  in_pool = false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  fn_ = nullptr;
+}
+
+void WorkPool::loop(unsigned self) {
+  in_pool = true;
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+    }
+    work(self);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_ == 0) done_.notify_one();
+  }
+}
+
+// No task is added while a batch runs, so once every queue is empty this
+// thread's share of the batch is over.
+void WorkPool::work(unsigned self) {
+  size_t task;
+  while (take(self, task)) (*fn_)(task);
+}
+
+bool WorkPool::take(unsigned self, size_t &task) {
+  {
+    Queue &own = queues_[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = own.tasks.front();
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (unsigned i = 1; i < nqueues_; i++) {
+    Queue &victim = queues_[(self + i) % nqueues_];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = victim.tasks.back();
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads that runs batches of independent tasks.
+//
+// run(n, fn) calls fn(0) ... fn(n - 1) and returns once all of them have
+// finished; the calling thread works too. Tasks are dealt out to one queue
+// per thread in contiguous ranges. A thread takes work from the front of
+// its own queue and, once that is empty, steals from the back of the
+// others, so a few slow tasks (one huge source file, one huge function) do
+// not leave the rest of the threads idle.
+//
+// A run() issued from inside a task runs its tasks inline on that thread.
+class WorkPool {
+ public:
+  explicit WorkPool(unsigned threads);
+  ~WorkPool();
+  WorkPool(const WorkPool &) = delete;
+  WorkPool &operator=(const WorkPool &) = delete;
+
+  unsigned size() const { return nqueues_; }
+  void run(size_t n, const std::function<void(size_t)> &fn);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  void loop(unsigned self);
+  void work(unsigned self);
+  bool take(unsigned self, size_t &task);
+
+  unsigned nqueues_;
+  std::unique_ptr<Queue[]> queues_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_, done_;
+  const std::function<void(size_t)> *fn_ = nullptr;
+  uint64_t generation_ = 0;
+  unsigned busy_ = 0;
+  bool stop_ = false;
+};
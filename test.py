@@ -3,6 +3,8 @@ import os
 import argparse
 import subprocess
 import datetime
+import time
+from concurrent.futures import ProcessPoolExecutor
 from tempfile import NamedTemporaryFile
 from dataclasses import dataclass
 
@@ -10,6 +12,7 @@ from dataclasses import dataclass
 
 TIMEOUT = 10
 IR_PATH = "./ir.py"
+IR_RUNNER = "native"  # "native": compiler --run, "python": ir.py
 VENUS_JAR = "./venus.jar"
 PYTHON_PATH = sys.executable  # always use the current python
 JAVA_PATH = "java"
@@ -72,6 +75,8 @@ class TestResult:
         self.test = test
         self.output = output
         self.exit_code = exit_code
+        self.compile_time = 0.0  # seconds, filled in by run_one_test
+        self.run_time = 0.0
         if test.should_fail:
             self.passed = exit_code != 0
         else:
@@ -85,33 +90,54 @@ class TestResult:
                     self.passed = exit_code == 0 and output == expected
 
 
+def timed(result: TestResult, start: float, compiled: float | None = None) -> TestResult:
+    """Record the time spent compiling and, if the compiler finished at
+    `compiled`, running the output since `start`."""
+    end = time.perf_counter()
+    if compiled is None:
+        result.compile_time = end - start
+    else:
+        result.compile_time = compiled - start
+        result.run_time = end - compiled
+    return result
+
+
 def run_one_test(compiler: str, test: Test, lab: str) -> TestResult:
     def run_only_compiler(compiler: str, test: Test) -> TestResult:  # lab1, lab2
         if test.inputs is None:  # no input
+            # lab1 tests only the parser; some of its programs are semantically invalid
+            command = [compiler, "--syntax-only" if lab == "lab1" else "--check", test.filename]
+            start = time.perf_counter()
             try:
-                result = subprocess.run(
-                    [compiler, test.filename], capture_output=True, timeout=TIMEOUT)
+                result = subprocess.run(command, capture_output=True, timeout=TIMEOUT)
             except subprocess.TimeoutExpired:
                 print(red(f"Error: {test.filename} timed out."))
-                return TestResult(test, None, -1)
+                return timed(TestResult(test, None, -1), start)
             # get exit code and output
             exit_code = result.returncode
             output = result.stdout.decode("utf-8")
-            return TestResult(test, output, exit_code)
+            return timed(TestResult(test, output, exit_code), start)
         assert False, "Not implemented input for lab1 or lab2"
 
     def run_with_ir(compiler: str, test: Test) -> TestResult:  # lab3
         ir_file = NamedTemporaryFile(suffix=".ll")
-        assert os.path.exists(IR_PATH), f"Error: {IR_PATH} not found."
+        assert IR_RUNNER == "native" or os.path.exists(IR_PATH), f"Error: {IR_PATH} not found."
         assert test.expected is not None, f"Error: {test.filename} has no expected output."
+        start = time.perf_counter()
+        compiled = None
         try:
             result = subprocess.run(
                 [compiler, test.filename, ir_file.name],
                 capture_output=True,
                 timeout=TIMEOUT)
+            compiled = time.perf_counter()
             if result.returncode != 0:  # compile error
-                return TestResult(test, None, result.returncode)
-            with subprocess.Popen([PYTHON_PATH, IR_PATH, "-t", ir_file.name],
+                return timed(TestResult(test, None, result.returncode), start, compiled)
+            if IR_RUNNER == "native":
+                ir_cmd = [compiler, "--run", "-t", ir_file.name]
+            else:
+                ir_cmd = [PYTHON_PATH, IR_PATH, "-t", ir_file.name]
+            with subprocess.Popen(ir_cmd,
                                   stdin=subprocess.PIPE,
                                   stdout=subprocess.PIPE,
                                   text=True) as p:
@@ -122,22 +148,25 @@ def run_one_test(compiler: str, test: Test, lab: str) -> TestResult:
                     outputs, _ = p.communicate(timeout=TIMEOUT)
                 outputs = outputs.strip().split("\n")
                 returnvalue = p.returncode
-                return TestResult(test, outputs, returnvalue)
+                return timed(TestResult(test, outputs, returnvalue), start, compiled)
         except subprocess.TimeoutExpired:
             print(red(f"Error: {test.filename} timed out."))
-            return TestResult(test, None, -1)
+            return timed(TestResult(test, None, -1), start, compiled)
 
     def run_with_jar(compiler: str, test: Test) -> TestResult:  # lab4
         assembly_file = NamedTemporaryFile(suffix=".s")
         assert os.path.exists(VENUS_JAR), f"Error: {VENUS_JAR} not found."
         assert test.expected is not None, f"Error: {test.filename} has no expected output."
+        start = time.perf_counter()
+        compiled = None
         try:
             result = subprocess.run(
                 [compiler, test.filename, assembly_file.name],
                 capture_output=True,
                 timeout=TIMEOUT)
+            compiled = time.perf_counter()
             if result.returncode != 0:  # compile error
-                return TestResult(test, None, result.returncode)
+                return timed(TestResult(test, None, result.returncode), start, compiled)
             with subprocess.Popen([JAVA_PATH, "-jar", VENUS_JAR, assembly_file.name],
                                   stdin=subprocess.PIPE,
                                   stdout=subprocess.PIPE,
@@ -150,10 +179,50 @@ def run_one_test(compiler: str, test: Test, lab: str) -> TestResult:
                 outputs = outputs.strip().split(
                     "\n")[0]  # remove last exit code line
                 returnvalue = p.returncode
-                return TestResult(test, outputs, returnvalue, concat_output=True)
+                return timed(TestResult(test, outputs, returnvalue, concat_output=True), start, compiled)
         except subprocess.TimeoutExpired:
             print(red(f"Error: {test.filename} timed out."))
-            return TestResult(test, None, -1)
+            return timed(TestResult(test, None, -1), start, compiled)
+
+    def run_with_both(compiler: str, test: Test) -> TestResult:  # vm
+        # The IR (a .ir test as is, or the compiler's output for a .sy) runs
+        # on both the compiler's interpreter and ir.py, without -t so that
+        # main's return value is compared too. Both must print the same and
+        # exit the same, and a test that should fail must trap with status 1.
+        ir_file = NamedTemporaryFile(suffix=".ir")
+        assert os.path.exists(IR_PATH), f"Error: {IR_PATH} not found."
+        start = time.perf_counter()
+        compiled = None
+        try:
+            ir_name = test.filename
+            if test.filename.endswith(".sy"):
+                result = subprocess.run(
+                    [compiler, test.filename, ir_file.name],
+                    capture_output=True,
+                    timeout=TIMEOUT)
+                if result.returncode != 0:  # compile error
+                    return timed(TestResult(test, None, result.returncode), start)
+                ir_name = ir_file.name
+            compiled = time.perf_counter()
+            runs = []
+            for ir_cmd in [[compiler, "--run", ir_name], [PYTHON_PATH, IR_PATH, ir_name]]:
+                p = subprocess.run(ir_cmd,
+                                   input="\n".join(test.inputs or []),
+                                   capture_output=True,
+                                   text=True,
+                                   timeout=TIMEOUT)
+                runs.append((p.stdout, p.returncode))
+            stdout, returnvalue = runs[0]
+            outputs = stdout.splitlines()
+            if returnvalue == 0:  # remove the exit code line
+                outputs = outputs[:-1]
+            result = TestResult(test, outputs, returnvalue)
+            result.passed = result.passed and runs[0] == runs[1] and \
+                (not test.should_fail or returnvalue == 1)
+            return timed(result, start, compiled)
+        except subprocess.TimeoutExpired:
+            print(red(f"Error: {test.filename} timed out."))
+            return timed(TestResult(test, None, -1), start, compiled)
 
     match lab:
         case "lab1" | "lab2":
@@ -162,6 +231,8 @@ def run_one_test(compiler: str, test: Test, lab: str) -> TestResult:
             return run_with_ir(compiler, test)
         case "lab4":
             return run_with_jar(compiler, test)
+        case "vm":
+            return run_with_both(compiler, test)
 
 
 def summary(test_results: list[TestResult]):
@@ -180,25 +251,56 @@ def summary(test_results: list[TestResult]):
         print(f"{passed}/{len(test_results)} tests passed.")
 
 
-def test_lab(compiler: str, lab: str) -> list[TestResult]:
+def timing_table(test_results: list[TestResult]):
+    # slowest first, so regressions show up at the top
+    max_filename = max([len(test_result.test.filename)
+                        for test_result in test_results])
+    print(f"{'test'.ljust(max_filename)}  {'compile':>9}  {'run':>9}  {'total':>9}")
+    for r in sorted(test_results, key=lambda r: r.compile_time + r.run_time, reverse=True):
+        print(f"{r.test.filename.ljust(max_filename)}  {r.compile_time * 1000:7.1f}ms"
+              f"  {r.run_time * 1000:7.1f}ms  {(r.compile_time + r.run_time) * 1000:7.1f}ms")
+    print()
+
+
+def set_ir_runner(ir_runner: str):
+    # settings changed on the command line, for worker processes
+    global IR_RUNNER
+    IR_RUNNER = ir_runner
+
+
+def test_lab(compiler: str, lab: str, jobs: int = 1) -> list[TestResult]:
     print(box(f"Running {lab} test..."))
     tests = os.listdir(f"tests/{lab}")
-    tests = filter(lambda x: x.endswith(".sy"), tests)  # only test .sy files
+    # only test .sy files; the vm tests also run .ir files directly
+    tests = filter(lambda x: x.endswith(".sy") or (lab == "vm" and x.endswith(".ir")), tests)
     tests = [Test.parse_file(f"tests/{lab}/{test}") for test in tests]
-    test_results = [run_one_test(compiler, test, lab) for test in tests]
-    return test_results
+    if jobs <= 1:
+        return [run_one_test(compiler, test, lab) for test in tests]
+    with ProcessPoolExecutor(max_workers=jobs, initializer=set_ir_runner,
+                             initargs=(IR_RUNNER,)) as pool:
+        return list(pool.map(run_one_test, [compiler] * len(tests), tests, [lab] * len(tests)))
 
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(description="Test your compiler.")
     parser.add_argument("input_file", type=str, help="Your complier file")
     parser.add_argument("lab", type=str, help="Which lab to test",
-                        choices=["lab1", "lab2", "lab3", "lab4"])
+                        choices=["lab1", "lab2", "lab3", "lab4", "vm"])
+    parser.add_argument("--ir", type=str, default=IR_RUNNER, choices=["native", "python"],
+                        help="How to run lab3 IR: the compiler's built-in interpreter or ir.py")
+    parser.add_argument("-j", "--jobs", type=int, default=1,
+                        help="Number of tests to run at once (0: one per CPU)")
     args = parser.parse_args()
+    IR_RUNNER = args.ir
     input_file, lab = args.input_file, args.lab
+    jobs = args.jobs if args.jobs > 0 else os.cpu_count() or 1
     if not os.path.exists(input_file):
         print(f"File {input_file} not found.")
         exit(1)
-    test_results = test_lab(input_file, lab)
+    start = time.perf_counter()
+    test_results = test_lab(input_file, lab, jobs)
+    elapsed = time.perf_counter() - start
+    timing_table(test_results)
     summary(test_results)
+    print(f"{len(test_results)} tests in {elapsed:.2f}s with {jobs} job(s)")
     print(datetime.datetime.now().strftime("%Y-%m-%d %H:%M:%S"))